@@ -0,0 +1,259 @@
+#ifndef JNP1_6_ANALYSIS_H
+#define JNP1_6_ANALYSIS_H
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "bytecode.h"
+
+namespace ooasm {
+    // Abstract state of memory and flags of computer during execution of bytecode, tracking
+    // values which are known without running it. It starts in state right after declarations of
+    // program, when untouched cells are zero, and flags, kept from previous boots, are unknown.
+    class StaticState {
+    public:
+        using word_t = Memory::word_t;
+        using address_t = Memory::address_t;
+        using mem_size_t = Memory::mem_size_t;
+        using value_t = std::optional<word_t>;
+        using flag_t = std::optional<bool>;
+
+        StaticState(const Bytecode &code, mem_size_t size) : _size(size) {
+            address_t slot = 0;
+            for (const Bytecode::Decl &decl : code.declarations()) {
+                if (slot < size) {
+                    cells[slot++] = decl.value;
+                }
+            }
+        }
+
+        [[nodiscard]] mem_size_t size() const {
+            return _size;
+        }
+
+        // Value of cell at address smaller than size of memory.
+        [[nodiscard]] value_t get(address_t i) const {
+            auto it = cells.find(i);
+            if (it != cells.end()) {
+                return it->second;
+            }
+            return clobbered ? value_t() : value_t(0);
+        }
+
+        void set(address_t i, value_t value) {
+            cells[i] = value;
+        }
+
+        // Cells declared or written so far, unless clobbered since.
+        [[nodiscard]] const std::unordered_map<address_t, value_t> &touched() const {
+            return cells;
+        }
+
+        // Forgets value of every cell, after write to unknown address.
+        void clobber() {
+            cells.clear();
+            clobbered = true;
+        }
+
+        [[nodiscard]] flag_t getZF() const {
+            return ZF;
+        }
+
+        [[nodiscard]] flag_t getSF() const {
+            return SF;
+        }
+
+        void set_flags(value_t res) {
+            ZF = res ? flag_t(*res == 0) : flag_t();
+            SF = res ? flag_t(*res < 0) : flag_t();
+        }
+
+        // Address to which operand of non-zero depth refers, if known. <proven> is cleared
+        // when any memory access made on the way cannot be shown to be in bounds.
+        [[nodiscard]] std::optional<address_t> address(const Bytecode::Operand &operand,
+                                                       bool &proven) const {
+            std::optional<address_t> addr;
+            if (operand.mode == Bytecode::Mode::Imm) {
+                addr = operand.value;
+            }
+            for (Bytecode::depth_t i = 1; i < operand.depth && addr; ++i) {
+                if (*addr >= size()) {
+                    addr.reset();
+                } else if (value_t value = get(*addr)) {
+                    addr = *value;
+                } else {
+                    addr.reset();
+                }
+            }
+            if (!addr || *addr >= size()) {
+                proven = false;
+                return std::nullopt;
+            }
+            return addr;
+        }
+
+        // Abstract counterpart of reading operand by computer::Processor.
+        [[nodiscard]] value_t load(const Bytecode::Operand &operand, bool &proven) const {
+            if (operand.depth == 0) {
+                return operand.mode == Bytecode::Mode::Imm ? value_t(operand.value) : value_t();
+            }
+            std::optional<address_t> addr = address(operand, proven);
+            return addr ? get(*addr) : value_t();
+        }
+
+        // Abstract counterpart of writing to operand by computer::Processor.
+        void store(const Bytecode::Operand &operand, value_t value, bool &proven) {
+            std::optional<address_t> addr = address(operand, proven);
+            if (addr) {
+                set(*addr, value);
+            } else {
+                clobber();
+            }
+        }
+
+        // Executes op abstractly, setting <dst_proven> and <src_proven> according to whether
+        // accesses made through its operands are proven to be in bounds. If op may fault, state
+        // afterwards describes the case when it did not, as otherwise nothing runs later.
+        void step(const Bytecode::Op &op, bool &dst_proven, bool &src_proven) {
+            dst_proven = src_proven = true;
+            switch (op.code) {
+                case Bytecode::Opcode::Mov: {
+                    value_t value = load(op.src, src_proven);
+                    store(op.dst, value, dst_proven);
+                    break;
+                }
+                case Bytecode::Opcode::Add:
+                case Bytecode::Opcode::Sub: {
+                    value_t a1 = load(op.dst, dst_proven);
+                    value_t a2 = load(op.src, src_proven);
+                    value_t res;
+                    if (a1 && a2) {
+                        auto u1 = static_cast<address_t>(*a1);
+                        auto u2 = static_cast<address_t>(*a2);
+                        res = static_cast<word_t>(op.code == Bytecode::Opcode::Add ? u1 + u2
+                                                                                   : u1 - u2);
+                    }
+                    set_flags(res);
+                    store(op.dst, res, dst_proven);
+                    break;
+                }
+                case Bytecode::Opcode::One:
+                    store(op.dst, 1, dst_proven);
+                    break;
+                case Bytecode::Opcode::OneZ:
+                    conditional_one(op.dst, ZF, dst_proven);
+                    break;
+                case Bytecode::Opcode::OneS:
+                    conditional_one(op.dst, SF, dst_proven);
+                    break;
+            }
+        }
+
+    private:
+        void conditional_one(const Bytecode::Operand &operand, flag_t flag, bool &proven) {
+            if (!flag.has_value()) {
+                std::optional<address_t> addr = address(operand, proven);
+                if (!addr) {
+                    clobber();
+                } else if (get(*addr) != value_t(1)) {
+                    set(*addr, std::nullopt);
+                }
+            } else if (*flag) {
+                store(operand, 1, proven);
+            }
+        }
+
+        mem_size_t _size;
+        bool clobbered = false;
+        std::unordered_map<address_t, value_t> cells;
+        flag_t ZF, SF;
+    };
+
+    // Which ops of bytecode, whose operands are verified, set flags which nothing observes.
+    // Flags are observed by onez and ones, at the end of program, as they are kept for the next
+    // boot, and by every op which may fault, as fault stops program with flags as they are.
+    // Arithmetic op sets flags after loading both operands and stores to cell it has just
+    // loaded, so it overwrites flags of earlier ops exactly when neither load may fault.
+    inline std::vector<bool> dead_flags(Span<Bytecode::Op> ops) {
+        auto safe = [](const Bytecode::Operand &operand) {
+            return operand.mode == Bytecode::Mode::Imm &&
+                   (operand.depth == 0 || operand.verified);
+        };
+        std::vector<bool> dead(ops.size(), false);
+        bool overwritten = false;
+        for (size_t i = ops.size(); i-- > 0;) {
+            const Bytecode::Op &op = ops[i];
+            switch (op.code) {
+                case Bytecode::Opcode::Add:
+                case Bytecode::Opcode::Sub:
+                    dead[i] = overwritten;
+                    overwritten = safe(op.dst) && safe(op.src);
+                    break;
+                case Bytecode::Opcode::OneZ:
+                case Bytecode::Opcode::OneS:
+                    overwritten = false;
+                    break;
+                case Bytecode::Opcode::Mov:
+                case Bytecode::Opcode::One:
+                    overwritten = overwritten && safe(op.dst) && safe(op.src);
+                    break;
+            }
+        }
+        return dead;
+    }
+
+    // Marks arithmetic ops of bytecode whose flags are dead, see dead_flags().
+    inline void mark_dead_flags(Bytecode &code) {
+        std::vector<bool> dead = dead_flags(code.code());
+        std::vector<Bytecode::Op> &ops = code.mutable_code();
+        for (size_t i = 0; i < ops.size(); ++i) {
+            ops[i].flags_dead = dead[i];
+        }
+    }
+
+    // Marks operands of bytecode whose memory accesses are proven to be in bounds when it is
+    // booted on memory of given size, so that execution can skip their checks, and arithmetic
+    // ops whose flags are dead on such memory.
+    inline void verify(Bytecode &code, Memory::mem_size_t size) {
+        StaticState state(code, size);
+        bool declared = code.declarations().size() <= size;
+        for (Bytecode::Op &op : code.mutable_code()) {
+            bool dst_proven = false;
+            bool src_proven = false;
+            if (declared) {
+                state.step(op, dst_proven, src_proven);
+            }
+            op.dst.verified = dst_proven;
+            op.src.verified = src_proven;
+        }
+        mark_dead_flags(code);
+        code.mark_verified(size);
+    }
+
+    // Whether every operand of bytecode marked as verified is proven to be in bounds for memory
+    // of given size and flags of ops marked as dead are, e.g. after bytecode was loaded from
+    // file.
+    inline bool sound(const Bytecode &code, Memory::mem_size_t size) {
+        StaticState state(code, size);
+        bool declared = code.declarations().size() <= size;
+        for (const Bytecode::Op &op : code.code()) {
+            bool dst_proven = false;
+            bool src_proven = false;
+            if (declared) {
+                state.step(op, dst_proven, src_proven);
+            }
+            if ((op.dst.verified && !dst_proven) || (op.src.verified && !src_proven)) {
+                return false;
+            }
+        }
+        std::vector<bool> dead = dead_flags(code.code());
+        for (size_t i = 0; i < dead.size(); ++i) {
+            if (code.code()[i].flags_dead && !dead[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+#endif //JNP1_6_ANALYSIS_H
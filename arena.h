@@ -0,0 +1,108 @@
+#ifndef JNP1_6_ARENA_H
+#define JNP1_6_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include "instruction.h"
+
+namespace ooasm {
+    // Deleter of language element nodes, which are allocated either on heap or in an arena.
+    // Nodes in arena are only destroyed, as their storage is released with the whole arena.
+    class NodeDeleter {
+    public:
+        NodeDeleter() = default;
+
+        explicit NodeDeleter(bool _in_arena) : in_arena(_in_arena) {}
+
+        // Nodes created by language elements are owned by std::unique_ptr.
+        template <typename T>
+        NodeDeleter(std::default_delete<T>) {}
+
+        template <typename T>
+        void operator()(T *node) const {
+            if (in_arena) {
+                node->~T();
+            } else {
+                delete node;
+            }
+        }
+
+    private:
+        bool in_arena = false;
+    };
+
+    template <typename T>
+    using node_ptr = std::unique_ptr<T, NodeDeleter>;
+
+    // Bump allocator placing language element nodes one after another in large blocks.
+    // Instructions created in arena are destroyed with it, and operand nodes by instructions
+    // owning them, so arena has to outlive everything created in it.
+    class Arena {
+    public:
+        Arena() = default;
+
+        Arena(const Arena &) = delete;
+
+        Arena &operator=(const Arena &) = delete;
+
+        ~Arena() {
+            for (Instruction *i : instructions) {
+                i->~Instruction();
+            }
+        }
+
+        // Reserves room for bookkeeping of given number of instructions.
+        void reserve(size_t count) {
+            instructions.reserve(count);
+        }
+
+        template <typename T, typename... Args>
+        node_ptr<T> make(Args &&... args) {
+            return node_ptr<T>(new(allocate(sizeof(T), alignof(T)))
+                                       T(std::forward<Args>(args)...), NodeDeleter(true));
+        }
+
+        template <typename T, typename... Args>
+        T *make_instruction(Args &&... args) {
+            void *place = allocate(sizeof(T), alignof(T));
+            instructions.push_back(nullptr);
+            try {
+                T *instruction = new(place) T(std::forward<Args>(args)...);
+                instructions.back() = instruction;
+                return instruction;
+            } catch (...) {
+                instructions.pop_back();
+                throw;
+            }
+        }
+
+    private:
+        static constexpr size_t block_size = 1 << 16;
+
+        std::vector<std::unique_ptr<std::byte[]>> blocks;
+        std::byte *next = nullptr;
+        size_t left = 0;
+        std::vector<Instruction *> instructions;
+
+        void *allocate(size_t size, size_t alignment) {
+            size_t padding = (alignment - reinterpret_cast<uintptr_t>(next) % alignment) %
+                             alignment;
+            if (next == nullptr || padding + size > left) {
+                blocks.emplace_back(new std::byte[block_size]);
+                next = blocks.back().get();
+                left = block_size;
+                padding = 0;
+            }
+            void *node = next + padding;
+            next += padding + size;
+            left -= padding + size;
+            return node;
+        }
+    };
+}
+
+#endif //JNP1_6_ARENA_H
@@ -0,0 +1,507 @@
+#ifndef JNP1_6_ASSEMBLER_H
+#define JNP1_6_ASSEMBLER_H
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "identifier.h"
+#include "ooasm.h"
+#include "thread_pool.h"
+
+#if defined(__unix__)
+#define OOASM_MAPPED_SOURCE 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define OOASM_MAPPED_SOURCE 0
+#endif
+
+namespace ooasm {
+    // Assembler of ooasm source text, which mirrors language elements of ooasm.h with one
+    // instruction per line, e.g.
+    //     data("a", num(5))
+    //     add(mem(lea("a")), mem(num(0))),
+    // Identifiers may also be written without quotes, trailing commas and blank lines are
+    // allowed, and // starts a comment. Source is tokenized in place, without copying, and large
+    // sources are split at line boundaries into chunks parsed in parallel. Errors, including use
+    // of undeclared identifier, are reported as SyntaxError with line and column.
+    class Assembler {
+    public:
+        // Assembler with its own pool of threads, kept for all sources it assembles.
+        explicit Assembler(size_t _threads = std::thread::hardware_concurrency())
+                : threads(std::max<size_t>(_threads, 1)) {
+            if (threads > 1) {
+                own_pool = std::make_unique<computer::ThreadPool>(threads);
+                pool = own_pool.get();
+            }
+        }
+
+        // Assembler parsing on threads of pool shared with other work, which has to outlive it.
+        explicit Assembler(computer::ThreadPool &_pool) : threads(_pool.size()), pool(&_pool) {}
+
+        [[nodiscard]] Program assemble(std::string_view source) const {
+            size_t chunks = threads == 1 ? 1 : std::min(threads * CHUNKS_PER_THREAD,
+                                                        source.size() / MIN_CHUNK + 1);
+            std::vector<std::string_view> texts = split(source, chunks);
+            std::vector<Part> parts(texts.size());
+            std::vector<std::exception_ptr> errors(texts.size());
+            auto parse_part = [&](size_t i) {
+                try {
+                    parse(texts[i], parts[i]);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            };
+            if (texts.size() == 1) {
+                parse_part(0);
+            } else {
+                pool->parallel_for(texts.size(), 1, parse_part);
+            }
+
+            // Lines before every part, so that positions in part are reported in whole source.
+            std::vector<size_t> lines(texts.size());
+            for (size_t i = 0; i < texts.size(); ++i) {
+                if (errors[i] != nullptr) {
+                    rethrow(errors[i], lines[i]);
+                }
+                if (i + 1 < texts.size()) {
+                    lines[i + 1] = lines[i] + std::count(texts[i].begin(), texts[i].end(), '\n');
+                }
+            }
+            check_declared(parts, lines);
+
+            ProgramBuilder program;
+            size_t size = 0;
+            for (const Part &part : parts) {
+                size += part.builder.size();
+            }
+            program.reserve(size);
+            for (Part &part : parts) {
+                program.append(std::move(part.builder));
+            }
+            return program.build();
+        }
+
+        // Assembles file mapped into memory.
+        [[nodiscard]] Program assemble_file(const std::string &path) const {
+            Source source(path);
+            return assemble(source.text());
+        }
+
+        class SyntaxError : public std::exception {
+        public:
+            SyntaxError(size_t line, size_t column, const std::string &problem)
+                    : _line(line), _column(column), _problem(problem),
+                      message("Syntax error at line " + std::to_string(line) + ", column " +
+                              std::to_string(column) + ": " + problem) {}
+
+            [[nodiscard]] const char *what() const noexcept override {
+                return message.c_str();
+            }
+
+            [[nodiscard]] size_t line() const {
+                return _line;
+            }
+
+            [[nodiscard]] size_t column() const {
+                return _column;
+            }
+
+            [[nodiscard]] const std::string &problem() const {
+                return _problem;
+            }
+
+        private:
+            size_t _line;
+            size_t _column;
+            std::string _problem;
+            std::string message;
+        };
+
+        class UnreadableFileException : public std::exception {
+            [[nodiscard]] const char *what() const noexcept override {
+                return "Source file cannot be read!";
+            }
+        };
+
+    private:
+        constexpr static size_t CHUNKS_PER_THREAD = 4;
+        constexpr static size_t MIN_CHUNK = 1 << 20;
+
+        size_t threads;
+        std::unique_ptr<computer::ThreadPool> own_pool;
+        computer::ThreadPool *pool = nullptr;
+
+        // Identifier used by lea, at position of its first character within part.
+        struct Use {
+            computer::PackedId id;
+            size_t line;
+            size_t column;
+        };
+
+        // Instructions of part of source, together with identifiers it declares and uses, as
+        // they can be declared in other parts.
+        struct Part {
+            ProgramBuilder builder;
+            std::vector<computer::PackedId> declared;
+            std::vector<Use> used;
+        };
+
+        // Contents of source file, mapped where possible.
+        class Source {
+        public:
+            explicit Source(const std::string &path) {
+#if OOASM_MAPPED_SOURCE
+                int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                struct stat info{};
+                if (fd < 0 || fstat(fd, &info) != 0) {
+                    if (fd >= 0) {
+                        close(fd);
+                    }
+                    throw UnreadableFileException();
+                }
+                length = static_cast<size_t>(info.st_size);
+                if (length > 0) {
+                    mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                }
+                close(fd);
+                if (mapping == MAP_FAILED) {
+                    throw UnreadableFileException();
+                }
+                if (mapping != nullptr) {
+                    madvise(mapping, length, MADV_SEQUENTIAL);
+                }
+#else
+                std::ifstream file(path, std::ios::binary);
+                if (!file) {
+                    throw UnreadableFileException();
+                }
+                std::ostringstream contents;
+                contents << file.rdbuf();
+                copy = contents.str();
+#endif
+            }
+
+            Source(const Source &) = delete;
+
+            Source &operator=(const Source &) = delete;
+
+            ~Source() {
+#if OOASM_MAPPED_SOURCE
+                if (mapping != nullptr && mapping != MAP_FAILED) {
+                    munmap(mapping, length);
+                }
+#endif
+            }
+
+            [[nodiscard]] std::string_view text() const {
+#if OOASM_MAPPED_SOURCE
+                if (mapping == nullptr) {
+                    return {};
+                }
+                return {static_cast<const char *>(mapping), length};
+#else
+                return copy;
+#endif
+            }
+
+        private:
+#if OOASM_MAPPED_SOURCE
+            void *mapping = nullptr;
+            size_t length = 0;
+#else
+            std::string copy;
+#endif
+        };
+
+        // Position in source part being parsed, with line and column counted from 1.
+        class Cursor {
+        public:
+            // Identifiers have at most 10 characters.
+            constexpr static size_t ID_BUFFER = 11;
+
+            explicit Cursor(std::string_view _text) : text(_text) {}
+
+            [[nodiscard]] bool at_end() const {
+                return pos == text.size();
+            }
+
+            [[nodiscard]] char peek() const {
+                return at_end() ? '\0' : text[pos];
+            }
+
+            [[nodiscard]] size_t line() const {
+                return _line;
+            }
+
+            [[nodiscard]] size_t column() const {
+                return pos - line_start + 1;
+            }
+
+            // Skips spaces and comment up to end of line.
+            void skip_blank() {
+                while (!at_end() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r')) {
+                    ++pos;
+                }
+                if (text.substr(pos, 2) == "//") {
+                    while (!at_end() && text[pos] != '\n') {
+                        ++pos;
+                    }
+                }
+            }
+
+            void next_line() {
+                ++pos;
+                ++_line;
+                line_start = pos;
+            }
+
+            void expect(char c) {
+                skip_blank();
+                if (peek() != c) {
+                    fail(std::string("expected '") + c + "'");
+                }
+                ++pos;
+            }
+
+            bool accept(char c) {
+                skip_blank();
+                if (peek() == c) {
+                    ++pos;
+                    return true;
+                }
+                return false;
+            }
+
+            std::string_view word() {
+                skip_blank();
+                size_t begin = pos;
+                while (!at_end() && (std::isalnum(static_cast<unsigned char>(text[pos])) ||
+                                     text[pos] == '_')) {
+                    ++pos;
+                }
+                return text.substr(begin, pos - begin);
+            }
+
+            // Identifier, quoted or bare, copied with terminating null into buffer.
+            const char *identifier(char (&buffer)[ID_BUFFER]) {
+                skip_blank();
+                size_t begin = pos;
+                std::string_view id;
+                if (accept('"')) {
+                    size_t end = text.find_first_of("\"\n", pos);
+                    if (end == std::string_view::npos || text[end] != '"') {
+                        fail("unterminated identifier");
+                    }
+                    id = text.substr(pos, end - pos);
+                    pos = end + 1;
+                } else {
+                    id = word();
+                }
+                if (id.empty() || id.size() > ID_BUFFER - 1) {
+                    pos = begin;
+                    fail("identifier has to have between 1 and 10 characters");
+                }
+                std::memcpy(buffer, id.data(), id.size());
+                buffer[id.size()] = '\0';
+                return buffer;
+            }
+
+            word_t number() {
+                skip_blank();
+                word_t value = 0;
+                auto [end, error] = std::from_chars(text.data() + pos, text.data() + text.size(),
+                                                    value);
+                if (error != std::errc()) {
+                    fail("invalid number");
+                }
+                pos = end - text.data();
+                return value;
+            }
+
+            [[noreturn]] void fail(const std::string &problem) const {
+                throw SyntaxError(_line, column(), problem);
+            }
+
+        private:
+            std::string_view text;
+            size_t pos = 0;
+            size_t _line = 1;
+            size_t line_start = 0;
+        };
+
+        // Splits source into about <chunks> parts ending with whole lines.
+        static std::vector<std::string_view> split(std::string_view source, size_t chunks) {
+            std::vector<std::string_view> parts;
+            size_t begin = 0;
+            for (size_t i = 1; i <= chunks && begin < source.size(); ++i) {
+                size_t end = i == chunks ? source.size() : source.size() / chunks * i;
+                if (end < begin) {
+                    continue;
+                }
+                end = source.find('\n', end);
+                end = end == std::string_view::npos ? source.size() : end + 1;
+                parts.push_back(source.substr(begin, end - begin));
+                begin = end;
+            }
+            if (parts.empty()) {
+                parts.push_back(source);
+            }
+            return parts;
+        }
+
+        // Rethrows error of part starting after <lines> lines, with line counted in whole source.
+        [[noreturn]] static void rethrow(const std::exception_ptr &error, size_t lines) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const SyntaxError &e) {
+                throw SyntaxError(e.line() + lines, e.column(), e.problem());
+            }
+        }
+
+        // Reports the first use of identifier which no part declares, as linking would fail.
+        static void check_declared(const std::vector<Part> &parts,
+                                   const std::vector<size_t> &lines) {
+            computer::IdTable declared;
+            for (const Part &part : parts) {
+                for (const computer::PackedId &id : part.declared) {
+                    declared.try_emplace(id, 0);
+                }
+            }
+            for (size_t i = 0; i < parts.size(); ++i) {
+                for (const Use &use : parts[i].used) {
+                    if (declared.find(use.id) == nullptr) {
+                        throw SyntaxError(lines[i] + use.line, use.column,
+                                          "undeclared identifier " + use.id.str());
+                    }
+                }
+            }
+        }
+
+        static void parse(std::string_view text, Part &part) {
+            Cursor cursor(text);
+            while (!cursor.at_end()) {
+                cursor.skip_blank();
+                if (cursor.peek() != '\n' && !cursor.at_end()) {
+                    instruction(cursor, part);
+                    cursor.accept(',');
+                    cursor.skip_blank();
+                    if (cursor.peek() != '\n' && !cursor.at_end()) {
+                        cursor.fail("expected end of line");
+                    }
+                }
+                if (!cursor.at_end()) {
+                    cursor.next_line();
+                }
+            }
+        }
+
+        static node_ptr<Mem> lvalue(Cursor &cursor, Part &part) {
+            cursor.skip_blank();
+            Cursor start = cursor;
+            if (cursor.word() != "mem") {
+                start.fail("expected mem");
+            }
+            cursor.expect('(');
+            node_ptr<RValue> addr = rvalue(cursor, part);
+            cursor.expect(')');
+            return part.builder.mem(std::move(addr));
+        }
+
+        static node_ptr<RValue> rvalue(Cursor &cursor, Part &part) {
+            cursor.skip_blank();
+            Cursor start = cursor;
+            std::string_view name = cursor.word();
+            if (name == "mem") {
+                cursor = start;
+                return lvalue(cursor, part);
+            }
+            if (name == "num") {
+                return num(cursor, part);
+            }
+            if (name == "lea") {
+                char buffer[Cursor::ID_BUFFER];
+                cursor.expect('(');
+                cursor.skip_blank();
+                Use use{{}, cursor.line(), cursor.column()};
+                const char *id = cursor.identifier(buffer);
+                use.id = computer::PackedId(id);
+                part.used.push_back(use);
+                cursor.expect(')');
+                return part.builder.lea(id);
+            }
+            start.fail("expected num, lea or mem");
+        }
+
+        static node_ptr<Num> num(Cursor &cursor, Part &part) {
+            cursor.expect('(');
+            word_t value = cursor.number();
+            cursor.expect(')');
+            return part.builder.num(value);
+        }
+
+        static void instruction(Cursor &cursor, Part &part) {
+            ProgramBuilder &builder = part.builder;
+            Cursor start = cursor;
+            std::string_view name = cursor.word();
+            if (name != "data" && name != "mov" && name != "add" && name != "sub" &&
+                name != "inc" && name != "dec" && name != "one" && name != "onez" &&
+                name != "ones") {
+                start.fail("unknown instruction");
+            }
+            cursor.expect('(');
+            if (name == "data") {
+                char buffer[Cursor::ID_BUFFER];
+                const char *id = cursor.identifier(buffer);
+                cursor.expect(',');
+                cursor.skip_blank();
+                Cursor value = cursor;
+                if (cursor.word() != "num") {
+                    value.fail("expected num");
+                }
+                part.declared.emplace_back(id);
+                builder.data(id, num(cursor, part));
+            } else if (name == "mov" || name == "add" || name == "sub") {
+                node_ptr<Mem> dst = lvalue(cursor, part);
+                cursor.expect(',');
+                node_ptr<RValue> src = rvalue(cursor, part);
+                if (name == "mov") {
+                    builder.mov(std::move(dst), std::move(src));
+                } else if (name == "add") {
+                    builder.add(std::move(dst), std::move(src));
+                } else {
+                    builder.sub(std::move(dst), std::move(src));
+                }
+            } else {
+                node_ptr<Mem> arg = lvalue(cursor, part);
+                if (name == "inc") {
+                    builder.inc(std::move(arg));
+                } else if (name == "dec") {
+                    builder.dec(std::move(arg));
+                } else if (name == "one") {
+                    builder.one(std::move(arg));
+                } else if (name == "onez") {
+                    builder.onez(std::move(arg));
+                } else {
+                    builder.ones(std::move(arg));
+                }
+            }
+            cursor.expect(')');
+        }
+    };
+}
+
+using ooasm::Assembler;
+
+#endif //JNP1_6_ASSEMBLER_H
@@ -0,0 +1,300 @@
+#ifndef JNP1_6_BINARY_FORMAT_H
+#define JNP1_6_BINARY_FORMAT_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "analysis.h"
+#include "bytecode.h"
+
+#if defined(__unix__)
+#define OOASM_MAPPED_BINARY 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define OOASM_MAPPED_BINARY 0
+#endif
+
+namespace ooasm {
+    // Precompiled program file (.ooasmb): header, ops and declarations in their in-memory
+    // layout, then identifiers, each as 32-bit length followed by characters. Loaded file is
+    // mapped and bytecode refers to its ops and declarations in place, so loading allocates
+    // only table of identifiers. Verification recorded in file is checked before it is trusted,
+    // so corrupted file cannot make engines skip bounds checks it needs.
+    class BinaryFormat {
+    public:
+        constexpr static uint32_t VERSION = 1;
+
+        static void save(const Bytecode &code, std::ostream &os) {
+            Header header = make_header(code);
+            write(os, &header, sizeof(header));
+            pad(os, header.ops_offset - sizeof(header));
+
+            // Padding inside ops is zeroed, so equal bytecodes give equal files.
+            constexpr size_t batch = 1024;
+            std::vector<Bytecode::Op> ops(batch);
+            Span<Bytecode::Op> code_ops = code.code();
+            for (size_t begin = 0; begin < code_ops.size(); begin += batch) {
+                size_t count = std::min(batch, code_ops.size() - begin);
+                std::memset(static_cast<void *>(ops.data()), 0, count * sizeof(Bytecode::Op));
+                for (size_t i = 0; i < count; ++i) {
+                    copy_op(code_ops[begin + i], ops[i]);
+                }
+                write(os, ops.data(), count * sizeof(Bytecode::Op));
+            }
+            for (const Bytecode::Decl &decl : code.declarations()) {
+                Bytecode::Decl clean;
+                std::memset(static_cast<void *>(&clean), 0, sizeof(clean));
+                clean.name = decl.name;
+                clean.value = decl.value;
+                write(os, &clean, sizeof(clean));
+            }
+            for (Bytecode::name_index_t i = 0; i < code.names_count(); ++i) {
+                const Memory::id_t &name = code.name(i);
+                auto length = static_cast<uint32_t>(name.size());
+                write(os, &length, sizeof(length));
+                write(os, name.data(), name.size());
+            }
+            if (!os) {
+                throw UnwritableFileException();
+            }
+        }
+
+        static void save(const Bytecode &code, const std::string &path) {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                throw UnwritableFileException();
+            }
+            save(code, file);
+        }
+
+        // Loads bytecode which refers to mapped file.
+        static Bytecode load(const std::string &path) {
+#if OOASM_MAPPED_BINARY
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat info{};
+            if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+                throw InvalidFileException();
+            }
+            auto length = static_cast<size_t>(info.st_size);
+            void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED) {
+                throw InvalidFileException();
+            }
+            std::shared_ptr<const void> owner(mapping, [length](const void *region) {
+                munmap(const_cast<void *>(region), length);
+            });
+            return load(std::move(owner), length);
+#else
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) {
+                throw InvalidFileException();
+            }
+            auto length = static_cast<size_t>(file.tellg());
+            // Words keep ops and declarations aligned.
+            std::shared_ptr<uint64_t[]> words(new uint64_t[length / sizeof(uint64_t) + 1]);
+            file.seekg(0);
+            file.read(reinterpret_cast<char *>(words.get()),
+                      static_cast<std::streamsize>(length));
+            if (!file) {
+                throw InvalidFileException();
+            }
+            return load(std::shared_ptr<const void>(words, words.get()), length);
+#endif
+        }
+
+        // Loads bytecode from file contents kept in memory by <owner>, which has to be aligned
+        // as ops are.
+        static Bytecode load(std::shared_ptr<const void> owner, size_t length) {
+            const auto *bytes = static_cast<const char *>(owner.get());
+            Header header{};
+            if (length < sizeof(header)) {
+                throw InvalidFileException();
+            }
+            std::memcpy(&header, bytes, sizeof(header));
+            check(header, length);
+
+            std::vector<Memory::id_t> names;
+            names.reserve(header.names_count);
+            size_t at = header.names_offset;
+            for (uint64_t i = 0; i < header.names_count; ++i) {
+                uint32_t name_length;
+                if (length - at < sizeof(name_length)) {
+                    throw InvalidFileException();
+                }
+                std::memcpy(&name_length, bytes + at, sizeof(name_length));
+                at += sizeof(name_length);
+                if (length - at < name_length) {
+                    throw InvalidFileException();
+                }
+                names.emplace_back(bytes + at, name_length);
+                at += name_length;
+            }
+
+            Span<Bytecode::Op> ops(
+                    reinterpret_cast<const Bytecode::Op *>(bytes + header.ops_offset),
+                    header.ops_count);
+            Span<Bytecode::Decl> decls(
+                    reinterpret_cast<const Bytecode::Decl *>(bytes + header.decls_offset),
+                    header.decls_count);
+            for (const Bytecode::Op &op : ops) {
+                check(op, names.size());
+            }
+            for (const Bytecode::Decl &decl : decls) {
+                if (decl.name >= names.size()) {
+                    throw InvalidFileException();
+                }
+            }
+
+            Bytecode code(std::move(owner), ops, decls, std::move(names));
+            if (header.verified != 0) {
+                if (!sound(code, header.verified_size)) {
+                    throw InvalidFileException();
+                }
+                code.mark_verified(header.verified_size);
+            }
+            return code;
+        }
+
+        class InvalidFileException : public std::exception {
+            [[nodiscard]] const char *what() const noexcept override {
+                return "File is not a compatible precompiled ooasm program!";
+            }
+        };
+
+        class UnwritableFileException : public std::exception {
+            [[nodiscard]] const char *what() const noexcept override {
+                return "Precompiled ooasm program cannot be written!";
+            }
+        };
+
+    private:
+        constexpr static char MAGIC[8] = {'O', 'O', 'A', 'S', 'M', 'B', '\r', '\n'};
+        // Written in native byte order, so files of machines with other order are rejected.
+        constexpr static uint32_t ORDER_MARK = 0x01020304;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            uint32_t op_size;
+            uint32_t decl_size;
+            uint32_t verified;
+            uint32_t reserved;
+            uint64_t verified_size;
+            uint64_t ops_count;
+            uint64_t ops_offset;
+            uint64_t decls_count;
+            uint64_t decls_offset;
+            uint64_t names_count;
+            uint64_t names_offset;
+        };
+
+        static Header make_header(const Bytecode &code) {
+            Header header{};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.byte_order = ORDER_MARK;
+            header.op_size = sizeof(Bytecode::Op);
+            header.decl_size = sizeof(Bytecode::Decl);
+            std::optional<Memory::mem_size_t> verified = code.verified_memory_size();
+            header.verified = verified.has_value();
+            header.verified_size = verified.value_or(0);
+            header.ops_count = code.code().size();
+            header.ops_offset = align(sizeof(Header));
+            header.decls_count = code.declarations().size();
+            header.decls_offset = align(header.ops_offset +
+                                        header.ops_count * sizeof(Bytecode::Op));
+            header.names_count = code.names_count();
+            header.names_offset = header.decls_offset +
+                                  header.decls_count * sizeof(Bytecode::Decl);
+            return header;
+        }
+
+        static uint64_t align(uint64_t offset) {
+            constexpr uint64_t alignment = alignof(Bytecode::Op);
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        static void check(const Header &header, size_t length) {
+            bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                         header.version == VERSION && header.byte_order == ORDER_MARK &&
+                         header.op_size == sizeof(Bytecode::Op) &&
+                         header.decl_size == sizeof(Bytecode::Decl) &&
+                         header.ops_offset % alignof(Bytecode::Op) == 0 &&
+                         header.decls_offset % alignof(Bytecode::Decl) == 0 &&
+                         fits(header.ops_offset, header.ops_count, sizeof(Bytecode::Op), length) &&
+                         fits(header.decls_offset, header.decls_count, sizeof(Bytecode::Decl),
+                              length) &&
+                         header.names_offset <= length &&
+                         header.names_count <= length;
+            if (!valid) {
+                throw InvalidFileException();
+            }
+        }
+
+        // Whether <count> elements of given size starting at <offset> lie within file.
+        static bool fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t length) {
+            return offset <= length && count <= (length - offset) / size;
+        }
+
+        static void check(const Bytecode::Op &op, size_t names) {
+            if (op.code > Bytecode::Opcode::OneS || op.dst.depth == 0) {
+                throw InvalidFileException();
+            }
+            uint8_t flags_dead;
+            std::memcpy(&flags_dead, &op.flags_dead, sizeof(flags_dead));
+            if (flags_dead > 1) {
+                throw InvalidFileException();
+            }
+            check(op.dst, names);
+            check(op.src, names);
+        }
+
+        static void check(const Bytecode::Operand &operand, size_t names) {
+            uint8_t verified;
+            std::memcpy(&verified, &operand.verified, sizeof(verified));
+            bool valid = verified <= 1 && (operand.mode == Bytecode::Mode::Imm ||
+                                           (operand.mode == Bytecode::Mode::Var &&
+                                            static_cast<uint64_t>(operand.value) < names));
+            if (!valid) {
+                throw InvalidFileException();
+            }
+        }
+
+        static void copy_op(const Bytecode::Op &from, Bytecode::Op &to) {
+            copy_operand(from.dst, to.dst);
+            copy_operand(from.src, to.src);
+            to.code = from.code;
+            to.flags_dead = from.flags_dead;
+        }
+
+        static void copy_operand(const Bytecode::Operand &from, Bytecode::Operand &to) {
+            to.value = from.value;
+            to.depth = from.depth;
+            to.mode = from.mode;
+            to.verified = from.verified;
+        }
+
+        static void write(std::ostream &os, const void *data, size_t size) {
+            os.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        }
+
+        static void pad(std::ostream &os, size_t count) {
+            static const char zeros[alignof(Bytecode::Op)] = {};
+            write(os, zeros, count);
+        }
+    };
+}
+
+#endif //JNP1_6_BINARY_FORMAT_H
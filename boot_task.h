@@ -0,0 +1,96 @@
+#ifndef JNP1_6_BOOT_TASK_H
+#define JNP1_6_BOOT_TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+namespace computer {
+    // Boot suspended between slices of its instructions, see BasicComputer::boot_async. It does
+    // nothing until resumed and can be resumed by any thread, but by one at a time. Destroying
+    // unfinished task abandons boot, leaving computer in state its last slice left.
+    class BootTask {
+    public:
+        struct promise_type {
+            BootTask get_return_object() {
+                return BootTask(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            std::suspend_always final_suspend() noexcept {
+                return {};
+            }
+
+            void return_void() {}
+
+            void unhandled_exception() {
+                error = std::current_exception();
+            }
+
+            std::exception_ptr error;
+        };
+
+        BootTask() = default;
+
+        BootTask(BootTask &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+        BootTask &operator=(BootTask &&other) noexcept {
+            if (this != &other) {
+                destroy();
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+
+        BootTask(const BootTask &) = delete;
+
+        BootTask &operator=(const BootTask &) = delete;
+
+        ~BootTask() {
+            destroy();
+        }
+
+        // Runs next slice of boot. Returns whether boot is finished, rethrowing exception which
+        // stopped it, e.g. fault of memory access.
+        bool resume() {
+            if (handle == nullptr) {
+                return true;
+            }
+            if (!handle.done()) {
+                handle.resume();
+            }
+            if (handle.done() && handle.promise().error) {
+                std::rethrow_exception(std::exchange(handle.promise().error, nullptr));
+            }
+            return handle.done();
+        }
+
+        // Runs remaining slices of boot.
+        void run() {
+            while (!resume()) {
+            }
+        }
+
+        [[nodiscard]] bool done() const {
+            return handle == nullptr || handle.done();
+        }
+
+    private:
+        explicit BootTask(std::coroutine_handle<promise_type> _handle) : handle(_handle) {}
+
+        void destroy() {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+        std::coroutine_handle<promise_type> handle;
+    };
+}
+
+using computer::BootTask;
+
+#endif //JNP1_6_BOOT_TASK_H
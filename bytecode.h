@@ -0,0 +1,230 @@
+#ifndef JNP1_6_BYTECODE_H
+#define JNP1_6_BYTECODE_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "computer_components.h"
+#include "linker.h"
+
+namespace ooasm {
+    using computer::Memory;
+
+    class Program;
+
+    // Read-only view of contiguous elements, kept either in vector or in external storage.
+    template <typename T>
+    class Span {
+    public:
+        Span(const T *_first, size_t _count) : first(_first), count(_count) {}
+
+        [[nodiscard]] const T *begin() const {
+            return first;
+        }
+
+        [[nodiscard]] const T *end() const {
+            return first + count;
+        }
+
+        [[nodiscard]] const T *data() const {
+            return first;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return count;
+        }
+
+        const T &operator[](size_t i) const {
+            return first[i];
+        }
+
+    private:
+        const T *first;
+        size_t count;
+    };
+
+    // Flat, contiguous form of ooasm program. Every instruction is a single Op, operands are
+    // encoded in place, so execution does not chase instruction trees.
+    class Bytecode {
+    public:
+        using word_t = Memory::word_t;
+        using depth_t = uint32_t;
+        using name_index_t = uint32_t;
+
+        enum class Opcode : uint8_t {
+            Mov, Add, Sub, One, OneZ, OneS
+        };
+
+        // Meaning of operand base value: numeric literal or index of identifier of variable
+        // whose address should be taken.
+        enum class Mode : uint8_t {
+            Imm, Var
+        };
+
+        // Operand is its base value dereferenced <depth> times, e.g. mem(mem(num(3))) is
+        // {3, 2, Imm}. Destination operands always have depth of at least 1. <verified> is set
+        // for operands whose memory accesses were proven to be in bounds, see verify().
+        struct Operand {
+            word_t value;
+            depth_t depth;
+            Mode mode;
+            bool verified;
+        };
+
+        // <flags_dead> is set by verify() for arithmetic ops whose flags nothing observes on
+        // memory of verified size, so that verified execution can skip working them out.
+        struct Op {
+            Operand dst;
+            Operand src;
+            Opcode code;
+            bool flags_dead = false;
+        };
+
+        // Variable declaration, in order of appearance in program.
+        struct Decl {
+            name_index_t name;
+            word_t value;
+        };
+
+        Bytecode() = default;
+
+        // Bytecode of program, sharing its boot image until declarations of bytecode change.
+        explicit Bytecode(const Program &program);
+
+        // Bytecode whose ops and declarations are kept in external storage, e.g. mapped file,
+        // which <owner> keeps alive. They are copied only once bytecode is modified.
+        Bytecode(std::shared_ptr<const void> owner, Span<Op> _ops, Span<Decl> _decls,
+                 std::vector<Memory::id_t> _names)
+                : external(std::move(owner)), external_ops(_ops), external_decls(_decls),
+                  names(std::move(_names)) {
+            for (name_index_t i = 0; i < names.size(); ++i) {
+                name_indices.try_emplace(names[i], i);
+            }
+        }
+
+        void emit(Opcode code, Operand dst, Operand src = {0, 0, Mode::Imm, false}) {
+            own();
+            ops.push_back({dst, src, code});
+            verified_size.reset();
+        }
+
+        void declare(const Memory::id_t &name, word_t value) {
+            own();
+            decls.push_back({intern(name), value});
+            forget_boot_image();
+        }
+
+        [[nodiscard]] name_index_t intern(const Memory::id_t &name) {
+            auto index = static_cast<name_index_t>(names.size());
+            if (!name_indices.try_emplace(name, index)) {
+                return static_cast<name_index_t>(*name_indices.find(name));
+            }
+            names.push_back(name);
+            return index;
+        }
+
+        // Replaces variable operands with addresses of variables' declarations.
+        void link() {
+            own();
+            Linker linker;
+            for (const Decl &decl : decls) {
+                linker.declare(names[decl.name]);
+            }
+            for (Op &op : ops) {
+                link(op.dst, linker);
+                link(op.src, linker);
+            }
+        }
+
+        // Access to ops for passes rewriting them. Invalidates verification, which marks of
+        // dead flags are part of.
+        [[nodiscard]] std::vector<Op> &mutable_code() {
+            own();
+            verified_size.reset();
+            return ops;
+        }
+
+        // Records that <verified> flags of operands hold for memory of given size.
+        void mark_verified(Memory::mem_size_t size) {
+            verified_size = size;
+        }
+
+        [[nodiscard]] bool verified_for(Memory::mem_size_t size) const {
+            return verified_size == size;
+        }
+
+        // Size of memory for which bytecode is verified, if any.
+        [[nodiscard]] std::optional<Memory::mem_size_t> verified_memory_size() const {
+            return verified_size;
+        }
+
+        [[nodiscard]] Span<Op> code() const {
+            if (external != nullptr) {
+                return external_ops;
+            }
+            return {ops.data(), ops.size()};
+        }
+
+        [[nodiscard]] Span<Decl> declarations() const {
+            if (external != nullptr) {
+                return external_decls;
+            }
+            return {decls.data(), decls.size()};
+        }
+
+        [[nodiscard]] const Memory::id_t &name(name_index_t index) const {
+            return names[index];
+        }
+
+        [[nodiscard]] size_t names_count() const {
+            return names.size();
+        }
+
+        // Image of memory after declarations of bytecode, cached by its boots. Copies share it
+        // until declarations of one of them change.
+        [[nodiscard]] computer::BootImageCache &boot_image() const {
+            return *boot_images;
+        }
+
+    private:
+        // Copies ops and declarations kept in external storage, so that they can be modified.
+        void own() {
+            if (external == nullptr) {
+                return;
+            }
+            ops.assign(external_ops.begin(), external_ops.end());
+            decls.assign(external_decls.begin(), external_decls.end());
+            external.reset();
+        }
+
+        // Image cached by earlier boots, which copies may share, no longer matches declarations.
+        void forget_boot_image() {
+            if (boot_images.use_count() > 1 || boot_images->get() != nullptr) {
+                boot_images = std::make_shared<computer::BootImageCache>();
+            }
+        }
+
+        void link(Operand &operand, const Linker &linker) const {
+            if (operand.mode == Mode::Var) {
+                operand.value = linker.resolve(names[operand.value]);
+                operand.mode = Mode::Imm;
+            }
+        }
+
+        std::shared_ptr<const void> external;
+        Span<Op> external_ops{nullptr, 0};
+        Span<Decl> external_decls{nullptr, 0};
+        std::vector<Op> ops;
+        std::optional<Memory::mem_size_t> verified_size;
+        std::vector<Decl> decls;
+        std::vector<Memory::id_t> names;
+        computer::IdTable name_indices;
+        std::shared_ptr<computer::BootImageCache> boot_images =
+                std::make_shared<computer::BootImageCache>();
+    };
+}
+
+#endif //JNP1_6_BYTECODE_H
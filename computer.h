@@ -2,52 +2,622 @@
 #define JNP1_6_COMPUTER_H
 
 #include "ooasm.h"
+#include <algorithm>
+#include <cstdint>
+#include <optional>
 #include <ostream>
+#include <type_traits>
+#include "analysis.h"
+#include "boot_task.h"
+#include "jit.h"
 #include "computer_components.h"
+#include "dump.h"
+#include "parallel.h"
+#include "partial.h"
+#include "trace.h"
 
 // Implementation detail namespace concerning computer abstraction parts.
 namespace computer {
     using ooasm::Instruction;
+    using ooasm::Bytecode;
+    using ooasm::PartialProgram;
+
+    // Way in which Computer executes programs: walking instruction objects, running bytecode
+    // compiled from them or running native code compiled from bytecode.
+    enum class Engine {
+        Tree, Bytecode, Jit
+    };
+
+    // Instruction trees, native code and static analyses work on 64-bit words, so computers
+    // with words of other widths run bytecode, checking every access.
+    template <typename Word>
+    constexpr bool native_width = std::is_same_v<Word, int64_t>;
+
+    // Derived class for processor with operations on ooasm instructions. Processors of words
+    // other than 64-bit run only bytecode.
+    template <typename Word>
+    class BasicProcessor : public BasicProcessorAbstract<Word> {
+        using Base = BasicProcessorAbstract<Word>;
 
-    // Derived class for processor with operations on ooasm instructions.
-    class Processor : public ProcessorAbstract {
     public:
-        explicit Processor(Memory &_mem) : ProcessorAbstract(_mem) {}
+        using Base::getZF;
+        using Base::getSF;
+        using Base::setZF;
+        using Base::setSF;
+        using Base::set_result;
+
+        explicit BasicProcessor(BasicMemory<Word> &_mem) : Base(_mem) {}
 
         void execute(const Instruction &ins) {
+#if OOASM_INSTRUMENT
+            uint64_t start = Instrumentation::cycles();
             ins.execute(*this, mem);
+            if (std::optional<Bytecode::Opcode> kind = ins.kind()) {
+                mem.instrumentation().executed(static_cast<size_t>(*kind),
+                                               Instrumentation::cycles() - start);
+            }
+#else
+            ins.execute(*this, mem);
+#endif
         }
 
         void declare(const Instruction &ins) {
             ins.declare(mem);
         }
+
+        void declare(const Bytecode &code) {
+            address_t slot = 0;
+            for (const Bytecode::Decl &decl : code.declarations()) {
+                word_t value = arithmetic_t::wrap(decl.value);
+                mem.add_variable(code.name(decl.name), value);
+                if (tracer != nullptr) {
+                    tracer->declared(slot++, value, getZF(), getSF());
+                }
+            }
+        }
+
+        void run(const Bytecode &code) {
+            if (tracer != nullptr) {
+                interpret<false, true>(code);
+            } else {
+                interpret<false, false>(code);
+            }
+        }
+
+        // Runs bytecode verified for memory of current size, skipping bounds checks of proven
+        // operands. Memory has to be in state right after declarations of the bytecode.
+        void run_verified(const Bytecode &code) {
+            run_verified(code, 0, code.code().size());
+        }
+
+        // Runs ops [begin, end) of verified bytecode on memory in state which running ops
+        // before them leaves.
+        void run_verified(const Bytecode &code, size_t begin, size_t end) {
+            if (tracer != nullptr) {
+                interpret<true, true>(code, begin, end);
+            } else {
+                interpret<true, false>(code, begin, end);
+            }
+        }
+
+        // Runs ops [begin, end) of bytecode on memory in state which running ops before them
+        // leaves.
+        void run(const Bytecode &code, size_t begin, size_t end) {
+            if (tracer != nullptr) {
+                interpret<false, true>(code, begin, end);
+            } else {
+                interpret<false, false>(code, begin, end);
+            }
+        }
+
+        // Runs bytecode without recording it even when tracing.
+        void run_untraced(const Bytecode &code) {
+            interpret<false, false>(code);
+        }
+
+        // Records declarations and writes of bytecode into given recorder, if any.
+        void trace(TraceRecorder *recorder) {
+            tracer = recorder;
+        }
+
+        [[nodiscard]] TraceRecorder *trace() const {
+            return tracer;
+        }
+
+    private:
+        using word_t = Word;
+        using address_t = MemoryBase::address_t;
+        using arithmetic_t = WordArithmetic<Word>;
+
+        using Base::mem;
+
+        template <bool Verified, bool Traced>
+        void interpret(const Bytecode &code, size_t begin = 0, size_t end = SIZE_MAX) {
+            ooasm::Span<Bytecode::Op> ops = code.code();
+            end = std::min(end, ops.size());
+            for (const Bytecode::Op &op : ooasm::Span<Bytecode::Op>(ops.data() + begin,
+                                                                    end - begin)) {
+                OOASM_PROBE(uint64_t start = Instrumentation::cycles();)
+                if constexpr (Traced) {
+                    traced_index = static_cast<uint64_t>(&op - ops.data());
+                }
+                switch (op.code) {
+                    case Bytecode::Opcode::Mov:
+                        store<Verified, Traced>(code, op.dst, load<Verified>(code, op.src));
+                        break;
+                    case Bytecode::Opcode::Add:
+                        arithmetic<Verified, Traced>(code, op, false);
+                        break;
+                    case Bytecode::Opcode::Sub:
+                        arithmetic<Verified, Traced>(code, op, true);
+                        break;
+                    case Bytecode::Opcode::One:
+                        store<Verified, Traced>(code, op.dst, 1);
+                        break;
+                    case Bytecode::Opcode::OneZ:
+                        if (getZF()) {
+                            store<Verified, Traced>(code, op.dst, 1);
+                        }
+                        break;
+                    case Bytecode::Opcode::OneS:
+                        if (getSF()) {
+                            store<Verified, Traced>(code, op.dst, 1);
+                        }
+                        break;
+                }
+                OOASM_PROBE(mem.instrumentation().executed(static_cast<size_t>(op.code),
+                                                           Instrumentation::cycles() - start);)
+            }
+        }
+
+        // Counterpart of ooasm::ArithmeticOperation, computed with wraparound at width of word.
+        // Verified execution skips flags marked as dead, except when tracing, as trace records
+        // flags after every write.
+        template <bool Verified, bool Traced>
+        void arithmetic(const Bytecode &code, const Bytecode::Op &op, bool subtract) {
+            word_t a1 = load<Verified>(code, op.dst);
+            word_t a2 = load<Verified>(code, op.src);
+            word_t res = subtract ? arithmetic_t::sub(a1, a2) : arithmetic_t::add(a1, a2);
+            if (!(Verified && !Traced && op.flags_dead)) {
+                set_result(res);
+            }
+            store<Verified, Traced>(code, op.dst, res);
+        }
+
+        [[nodiscard]] address_t base(const Bytecode &code, const Bytecode::Operand &operand) const {
+            if (operand.mode == Bytecode::Mode::Var) {
+                return mem.get_variable_address(code.name(operand.value));
+            }
+            return static_cast<address_t>(operand.value);
+        }
+
+        template <bool Verified>
+        [[nodiscard]] word_t read(const Bytecode::Operand &operand, address_t addr) const {
+            if (Verified && operand.verified) {
+                return mem.get_unchecked(addr);
+            }
+            return mem.at(addr);
+        }
+
+        // Address to which operand of non-zero depth refers.
+        template <bool Verified>
+        [[nodiscard]] address_t address(const Bytecode &code,
+                                        const Bytecode::Operand &operand) const {
+            address_t addr = base(code, operand);
+            for (Bytecode::depth_t i = 1; i < operand.depth; ++i) {
+                addr = arithmetic_t::address(read<Verified>(operand, addr));
+            }
+            return addr;
+        }
+
+        template <bool Verified>
+        [[nodiscard]] word_t load(const Bytecode &code, const Bytecode::Operand &operand) const {
+            if (operand.depth == 0) {
+                return arithmetic_t::wrap(base(code, operand));
+            }
+            return read<Verified>(operand, address<Verified>(code, operand));
+        }
+
+        template <bool Verified, bool Traced>
+        void store(const Bytecode &code, const Bytecode::Operand &operand, word_t word) {
+            address_t addr = address<Verified>(code, operand);
+            if constexpr (Traced) {
+                mem.check_address(addr);
+                tracer->written(traced_index, addr, mem.data()[addr], word, getZF(), getSF());
+            }
+            if (Verified && operand.verified) {
+                mem.set_unchecked(addr, word);
+            } else {
+                mem.set(addr, word);
+            }
+        }
+
+        TraceRecorder *tracer = nullptr;
+        // Index of op being interpreted with tracing.
+        uint64_t traced_index = 0;
+    };
+
+    using Processor = BasicProcessor<int64_t>;
+
+    // State of computer: memory with its variables and flags of processor.
+    template <typename Word>
+    struct BasicSnapshot {
+        typename BasicMemory<Word>::Snapshot memory;
+        ProcessorAbstract::flag_t ZF;
+        ProcessorAbstract::flag_t SF;
     };
 
+    using Snapshot = BasicSnapshot<int64_t>;
+
     // Class for abstract computer being environment of ooasm execution.
-    class Computer {
+    // Computer with memory of words of given signed type, wrapping around at its width.
+    template <typename Word>
+    class BasicComputer {
     public:
-        explicit Computer(size_t mem_size) : mem(mem_size), proc(mem) {}
+        using word_t = Word;
+        using snapshot_t = BasicSnapshot<Word>;
 
-        void boot(const ooasm::Program &p) {
-            mem.wipe();
+        explicit BasicComputer(size_t mem_size, Backing backing = Backing::Automatic)
+                : mem(mem_size, backing), proc(mem) {}
+
+        // Computer in state of snapshot, sharing its memory until written.
+        explicit BasicComputer(const snapshot_t &snapshot) : mem(0), proc(mem) {
+            restore(snapshot);
+        }
+
+        // Processor refers to memory of its computer, so computers cannot be copied or moved.
+        BasicComputer(const BasicComputer &) = delete;
+
+        BasicComputer &operator=(const BasicComputer &) = delete;
+
+        // Traced boots run bytecode whatever the engine, so that every write is recorded.
+        // Computers of words other than 64-bit always run bytecode. Native code is compiled by
+        // the first JIT boot on memory of given size and cached in program for the next ones.
+        void boot(const ooasm::Program &p, Engine engine = Engine::Tree) {
+            if constexpr (native_width<Word>) {
+                if (engine == Engine::Tree && !tracing()) {
+                    OOASM_PROBE(Instrumentation::Boot probe(mem.instrumentation());)
+                    declare(p.boot_image(), [&] {
+                        for (const std::shared_ptr<Instruction> &ins : p) {
+                            proc.declare(*ins);
+                        }
+                    });
+                    for (const std::shared_ptr<Instruction> &ins : p) {
+                        proc.execute(*ins);
+                    }
+                    return;
+                }
+            }
+            if constexpr (native_width<Word>) {
+                if (engine == Engine::Jit && !tracing()) {
+                    JitCache::program_ptr jit = p.jit().get(mem.size());
+                    if (jit == nullptr) {
+                        Bytecode code(p);
+                        ooasm::verify(code, mem.size());
+                        jit = std::make_shared<const JitProgram>(std::move(code), mem.size());
+                        p.jit().set(jit);
+                    }
+                    boot(*jit);
+                    return;
+                }
+            }
+            Bytecode code(p);
+            if constexpr (native_width<Word>) {
+                ooasm::verify(code, mem.size());
+            }
+            boot(code);
+        }
 
-            for (const std::shared_ptr<Instruction> &ins : p) {
-                proc.declare(*ins);
+        // Boots program previously compiled to bytecode, which can be shared between boots.
+        // Bytecode verified for memory of this size runs without checks of proven accesses,
+        // unless words are narrower than those verification assumed.
+        void boot(const Bytecode &code) {
+            OOASM_PROBE(Instrumentation::Boot probe(mem.instrumentation());)
+            start(code);
+            if (native_width<Word> && code.verified_for(mem.size())) {
+                proc.run_verified(code);
+            } else {
+                proc.run(code);
             }
-            for (const std::shared_ptr<Instruction> &ins : p) {
-                proc.execute(*ins);
+        }
+
+        // Boot of bytecode which suspends after every <fuel> instructions, so that scheduler
+        // can interleave it with boots of other computers. Neither computer nor bytecode may be
+        // destroyed or booted otherwise before returned task finishes. Boots run in slices are
+        // not counted by instrumentation, as slices may run on different threads.
+        [[nodiscard]] BootTask boot_async(const Bytecode &code, size_t fuel) {
+            return boot_slices<const Bytecode &>(code, fuel);
+        }
+
+        // Boot of program compiled to bytecode which task owns, so that program can be
+        // destroyed before it finishes.
+        [[nodiscard]] BootTask boot_async(const ooasm::Program &p, size_t fuel) {
+            Bytecode code(p);
+            if constexpr (native_width<Word>) {
+                ooasm::verify(code, mem.size());
             }
+            return boot_slices<Bytecode>(std::move(code), fuel);
         }
 
-        void memory_dump(std::ostream &os) const {
-            for (size_t i = 0; i < mem.size(); ++i) {
-                os << static_cast<long long>(mem.at(i)) << " ";
+        // Boots natively compiled program, falling back to interpreting its bytecode when it
+        // could not be compiled or was compiled for memory of different size.
+        void boot(const JitProgram &program) {
+            if constexpr (native_width<Word>) {
+                if (program.compiled_for(mem.size()) && !tracing()) {
+                    OOASM_PROBE(Instrumentation::Boot probe(mem.instrumentation());)
+                    declare(program.bytecode());
+                    program.run(mem, proc);
+                    return;
+                }
             }
+            boot(program.bytecode());
+        }
+
+        // Continues execution from current state, without wiping memory and declaring
+        // variables, e.g. on a fork of computer stopped in the middle of other program. Such
+        // execution is not traced.
+        void run(const ooasm::Program &p) {
+            if constexpr (native_width<Word>) {
+                forget_snapshot();
+                for (const std::shared_ptr<Instruction> &ins : p) {
+                    proc.execute(*ins);
+                }
+            } else {
+                run(Bytecode(p));
+            }
+        }
+
+        void run(const Bytecode &code) {
+            forget_snapshot();
+            proc.run_untraced(code);
+        }
+
+        // The first snapshot of state copies pages of memory written since its previous
+        // snapshot or restore, and memory maps that copy afterwards. Later snapshots of the
+        // same state share it, and so do computers restored from them, copy-on-write, so that
+        // each pays only for pages it writes. Not to be taken by several threads at once.
+        [[nodiscard]] snapshot_t snapshot() const {
+            if (!shared) {
+                shared.emplace(snapshot_t{mem.snapshot(), proc.getZF(), proc.getSF()});
+            }
+            return *shared;
+        }
+
+        // Restores state of snapshot, including size of memory.
+        void restore(const snapshot_t &snapshot) {
+            mem.restore(snapshot.memory);
+            proc.setZF(snapshot.ZF);
+            proc.setSF(snapshot.SF);
+            shared = snapshot;
+        }
+
+        // Independent computer in current state of this one, sharing pages of memory with it
+        // until either of them writes them.
+        [[nodiscard]] BasicComputer fork() const {
+            return BasicComputer(snapshot());
+        }
+
+        // Boots partially evaluated program by copying its image and running residual. Memory
+        // of size it was not evaluated for boots whole program instead.
+        void boot(const PartialProgram &program) {
+            if constexpr (native_width<Word>) {
+                if (program.evaluated_for(mem.size()) && !tracing()) {
+                    OOASM_PROBE(Instrumentation::Boot probe(mem.instrumentation());)
+                    declare(program.residual());
+                    word_t *words = mem.data();
+                    for (const PartialProgram::Run &run : program.runs()) {
+                        std::copy_n(program.words().data() + run.offset, run.length,
+                                    words + run.begin);
+                    }
+                    if (program.getZF().has_value()) {
+                        proc.setZF(*program.getZF());
+                    }
+                    if (program.getSF().has_value()) {
+                        proc.setSF(*program.getSF());
+                    }
+                    if (program.residual_verified()) {
+                        proc.run_verified(program.residual());
+                    } else {
+                        proc.run(program.residual());
+                    }
+                    return;
+                }
+            }
+            boot(program.bytecode());
+        }
+
+        // Boots program split for parallel execution, running its independent chains on
+        // threads of pool. Memory of size it was not split for, or tracing, boots it
+        // sequentially instead.
+        void boot(const ParallelProgram &program, ThreadPool &pool) {
+            if constexpr (native_width<Word>) {
+                if (program.split_for(mem.size()) && !tracing()) {
+                    OOASM_PROBE(Instrumentation::Boot probe(mem.instrumentation());)
+                    declare(program.bytecode());
+                    for (const ParallelProgram::Segment &segment : program.segments()) {
+                        if (!segment.parallel) {
+                            proc.run_verified(program.bytecode(), segment.begin, segment.end);
+                            continue;
+                        }
+                        ParallelProgram::Flags flags{proc.getZF(), proc.getSF()};
+                        program.run(segment, mem.data(), flags, pool);
+                        set_flags({flags.ZF, flags.SF});
+                    }
+                    return;
+                }
+            }
+            boot(program.bytecode());
+        }
+
+        [[nodiscard]] size_t memory_size() const {
+            return mem.size();
+        }
+
+        // Word at address smaller than size of memory.
+        [[nodiscard]] word_t at(Memory::address_t i) const {
+            return mem.data()[i];
+        }
+
+        [[nodiscard]] bool getZF() const {
+            return proc.getZF();
+        }
+
+        [[nodiscard]] bool getSF() const {
+            return proc.getSF();
+        }
+
+        void memory_dump(std::ostream &os) const {
+            dump_text(mem.data(), mem.size(), os);
         };
+
+        // Writes raw words of memory, to be compared with diff or loaded back.
+        void memory_dump_binary(std::ostream &os) const {
+            dump_binary(mem.data(), mem.size(), os);
+        }
+
+        // Ranges of addresses at which memories of computers differ.
+        [[nodiscard]] std::vector<Range> diff(const BasicComputer &other) const {
+            return computer::diff(mem.data(), mem.size(), other.mem.data(), other.mem.size());
+        }
+
+        // Ranges of addresses at which memory differs from binary dump.
+        [[nodiscard]] std::vector<Range> diff(std::istream &dump) const {
+            return computer::diff(mem.data(), mem.size(), dump);
+        }
+
+        // Starts recording declarations and writes of following boots into trace file, which
+        // TraceReplay reads. Boots of natively compiled and partially evaluated programs
+        // interpret their bytecode instead while tracing.
+        void trace(const std::string &path) {
+            stop_trace();
+            recorder = std::make_unique<TraceRecorder>(path);
+            proc.trace(recorder.get());
+        }
+
+        [[nodiscard]] bool tracing() const {
+            return recorder != nullptr;
+        }
+
+        // Waits until boots traced so far are in trace file.
+        void flush_trace() {
+            if (recorder) {
+                recorder->flush();
+            }
+        }
+
+        // Stops tracing and closes trace file.
+        void stop_trace() {
+            proc.trace(nullptr);
+            recorder.reset();
+        }
+
+        // Puts computer in state of traced boot right before op at <index>, replaying it from
+        // start. Variables are not restored, as trace records only their addresses.
+        void replay(const TraceReplay &trace, size_t boot, uint64_t index) {
+            forget_snapshot();
+            set_flags(trace.replay(mem, boot, index));
+        }
+
+        // Puts computer which is in state traced boot left it in into state right before op
+        // at <index>, undoing writes of later ops.
+        void rewind(const TraceReplay &trace, size_t boot, uint64_t index) {
+            forget_snapshot();
+            set_flags(trace.rewind(mem, boot, index));
+        }
+
+#if OOASM_INSTRUMENT
+        // Statistics of boots of this computer, e.g. for enabling hardware counters.
+        [[nodiscard]] Instrumentation &instrumentation() {
+            return mem.instrumentation();
+        }
+
+        [[nodiscard]] const Instrumentation &instrumentation() const {
+            return mem.instrumentation();
+        }
+
+        // Writes statistics as JSON, naming variables declared by the last boot.
+        void statistics_dump(std::ostream &os) const {
+            mem.instrumentation().write_json(os, mem.variables());
+        }
+#endif
     private:
-        Memory mem;
-        Processor proc;
+        // Wipes memory and declares variables of bytecode at the start of its boot. Traced
+        // boots record every declaration.
+        void start(const Bytecode &code) {
+            if (tracing()) {
+                forget_snapshot();
+                mem.wipe();
+                recorder->boot(mem.size(), proc.getZF(), proc.getSF());
+                proc.declare(code);
+                return;
+            }
+            declare(code);
+        }
+
+        void declare(const Bytecode &code) {
+            declare(code.boot_image(), [&] { proc.declare(code); });
+        }
+
+        // Wipes memory and declares variables, by restoring image cached by earlier boots of
+        // the same program if it fits in memory, or by <declare_all> otherwise, caching image
+        // it leaves. Images are of 64-bit words, so narrower computers always declare.
+        template <typename Declare>
+        void declare(BootImageCache &cache, Declare declare_all) {
+            forget_snapshot();
+            if constexpr (native_width<Word>) {
+                BootImageCache::image_ptr image = cache.get();
+                if (image != nullptr && image->words.size() <= mem.size()) {
+                    mem.wipe(*image);
+                    return;
+                }
+            }
+            mem.wipe();
+            declare_all();
+            if constexpr (native_width<Word>) {
+                cache.set(mem.boot_image());
+            }
+        }
+
+        // Coroutine of boot_async, which keeps bytecode as <Code>: either reference or value.
+        template <typename Code>
+        BootTask boot_slices(Code code, size_t fuel) {
+            fuel = std::max<size_t>(fuel, 1);
+            start(code);
+            bool verified = native_width<Word> && code.verified_for(mem.size());
+            size_t size = code.code().size();
+            for (size_t begin = 0; begin < size; begin += fuel) {
+                size_t end = begin + std::min(fuel, size - begin);
+                if (verified) {
+                    proc.run_verified(code, begin, end);
+                } else {
+                    proc.run(code, begin, end);
+                }
+                if (end < size) {
+                    co_await std::suspend_always();
+                    forget_snapshot();
+                }
+            }
+        }
+
+        // State changes, so that the next snapshot has to be taken anew. Every boot starts
+        // with declarations, which forget it.
+        void forget_snapshot() {
+            shared.reset();
+        }
+
+        void set_flags(TraceReplay::Flags flags) {
+            proc.setZF(flags.ZF);
+            proc.setSF(flags.SF);
+        }
+
+        BasicMemory<Word> mem;
+        BasicProcessor<Word> proc;
+        std::unique_ptr<TraceRecorder> recorder;
+        // Snapshot of current state, if taken since state last changed.
+        mutable std::optional<snapshot_t> shared;
     };
+
+    using Computer = BasicComputer<int64_t>;
 }
 
 using computer::Computer;
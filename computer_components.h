@@ -1,117 +1,301 @@
 #ifndef JNP1_6_COMPUTER_COMPONENTS_H
 #define JNP1_6_COMPUTER_COMPONENTS_H
 
+#include <algorithm>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <unordered_map>
 #include <string>
+#include <vector>
+#include "identifier.h"
+#include "instrument.h"
+#include "storage.h"
+#include "word.h"
 
 namespace computer {
-    // Class for memory storing data on which ooasm instructions operate.
-    class Memory {
+    // Types and exceptions shared by memories of all word widths, so that accesses out of
+    // range are caught alike whatever the width.
+    class MemoryBase {
     public:
-        using word_t = int64_t;
         using address_t = uint64_t;
         using mem_size_t = uint64_t;
         using id_t = std::string;
 
-        explicit Memory(mem_size_t size) : _size(size), mem(std::make_unique<mem_t>(size)) {
-            for (mem_size_t i = 0; i < _size; ++i) {
-                mem[i] = 0;
+        // Exceptions are public so that other execution engines can raise the same ones.
+        class OutOfRangeMemoryAccessException : public std::exception {
+            [[nodiscard]] const char *what() const noexcept override {
+                return "Address larger than size of memory cannot be accessed!";
             }
-        }
+        };
 
-        [[nodiscard]] word_t at(address_t i) const {
-            if (i >= size()) {
-                throw OutOfRangeMemoryAccessException();
+        class TooManyVariablesException : public std::exception {
+            [[nodiscard]] const char *what() const noexcept override {
+                return "Too many variable declarations!";
             }
+        };
+    };
+
+    // Class for memory storing data on which ooasm instructions operate, in words of given
+    // signed type. Narrower words take less space, at the cost of wrapping around sooner.
+    template <typename Word>
+    class BasicMemory : public MemoryBase {
+    public:
+        using word_t = Word;
+        using arithmetic_t = WordArithmetic<Word>;
+
+        // Memories of huge size are paged by default, so only words in use take space.
+        explicit BasicMemory(mem_size_t size, Backing backing = Backing::Automatic)
+                : _size(size), mem(size, backing) {}
+
+        // Copy of memory contents and variables, which memories restored from it share until
+        // they write to it.
+        class Snapshot {
+        public:
+            [[nodiscard]] mem_size_t size() const {
+                return image->size();
+            }
+
+        private:
+            friend class BasicMemory;
+
+            Snapshot(std::shared_ptr<const BasicImage<Word>> _image, IdTable _vars,
+                     mem_size_t _variables_count)
+                    : image(std::move(_image)), vars(std::move(_vars)),
+                      variables_count(_variables_count) {}
+
+            std::shared_ptr<const BasicImage<Word>> image;
+            IdTable vars;
+            mem_size_t variables_count;
+        };
+
+        // Words and addresses of variables, as declarations of program leave them in wiped
+        // memory of any size they fit in.
+        struct BootImage {
+            std::vector<word_t> words;
+            IdTable vars;
+        };
+
+        [[nodiscard]] word_t at(address_t i) const {
+            check_address(i);
+            OOASM_PROBE(probe.read(i);)
             return mem[i];
         }
 
         void set(address_t i, word_t new_val) {
+            check_address(i);
+            OOASM_PROBE(probe.written(i);)
+            mem[i] = new_val;
+        }
+
+        // Accessors for addresses already proven to be smaller than size of memory.
+        [[nodiscard]] word_t get_unchecked(address_t i) const {
+            OOASM_PROBE(probe.read(i);)
+            return mem[i];
+        }
+
+        void set_unchecked(address_t i, word_t new_val) {
+            OOASM_PROBE(probe.written(i);)
+            mem[i] = new_val;
+        }
+
+        // Raw words of memory, for execution engines working on them directly.
+        [[nodiscard]] word_t *data() {
+            return mem.get();
+        }
+
+        [[nodiscard]] const word_t *data() const {
+            return mem.get();
+        }
+
+        void check_address(address_t i) const {
             if (i >= size()) {
+                OOASM_PROBE(probe.out_of_range();)
                 throw OutOfRangeMemoryAccessException();
             }
-            mem[i] = new_val;
         }
 
         [[nodiscard]] address_t get_variable_address(const id_t &var_name) const {
-            return vars.at(var_name);
+            OOASM_PROBE(probe.looked_up();)
+            return variable_address(vars.find(var_name));
+        }
+
+        [[nodiscard]] address_t get_variable_address(const PackedId &var_name) const {
+            OOASM_PROBE(probe.looked_up();)
+            return variable_address(vars.find(var_name));
         }
 
         void add_variable(const id_t &var_name, word_t word) {
-            if (variables_count == size()) {
-                throw TooManyVariablesException();
-            }
-            set(variables_count, word);
-            if (vars.count(var_name) == 0) {
-                vars[var_name] = variables_count;
-            }
-            variables_count++;
+            declare_variable(word);
+            vars.try_emplace(var_name, variables_count++);
+        }
+
+        void add_variable(const PackedId &var_name, word_t word) {
+            declare_variable(word);
+            vars.try_emplace(var_name, variables_count++);
         }
 
         [[nodiscard]] mem_size_t size() const {
             return _size;
         }
 
+        // Addresses of variables declared since memory was last wiped.
+        [[nodiscard]] const IdTable &variables() const {
+            return vars;
+        }
+
+#if OOASM_INSTRUMENT
+        // Statistics of accesses, collected also from const accessors.
+        [[nodiscard]] Instrumentation &instrumentation() const {
+            return probe;
+        }
+#endif
+
         void wipe() {
-            for (mem_size_t i = 0; i < size(); i++) {
-                mem[i] = 0;
-            }
+            mem.zero();
 
             vars.clear();
             variables_count = 0;
         }
 
+        // Image of variables declared since memory was last wiped.
+        [[nodiscard]] std::shared_ptr<const BootImage> boot_image() const {
+            return std::make_shared<const BootImage>(
+                    BootImage{{mem.get(), mem.get() + variables_count}, vars});
+        }
+
+        // Wipes memory and declares variables of image at once, which is what declaring them
+        // one by one would leave, provided they fit.
+        void wipe(const BootImage &image) {
+            mem.zero();
+            std::copy(image.words.begin(), image.words.end(), mem.get());
+            vars = image.vars;
+            variables_count = image.words.size();
+            OOASM_PROBE(for (address_t i = 0; i < variables_count; ++i) {
+                probe.declared();
+                probe.written(i);
+            })
+        }
+
+        // Memory keeps its contents, but unless dense, maps them from image of snapshot
+        // afterwards, so that its next snapshot reads only pages written since.
+        [[nodiscard]] Snapshot snapshot() const {
+            return Snapshot(mem.snapshot(), vars, variables_count);
+        }
+
+        // Restores contents and variables of snapshot, taking over its size.
+        void restore(const Snapshot &snapshot) {
+            mem.load(snapshot.image);
+            _size = snapshot.size();
+            vars = snapshot.vars;
+            variables_count = snapshot.variables_count;
+        }
+
     private:
-        class OutOfRangeMemoryAccessException : public std::exception {
-            [[nodiscard]] const char *what() const noexcept override {
-                return "Address larger than size of memory cannot be accessed!";
+        // Writes word of variable about to be declared. Only the first declaration of given
+        // identifier is visible.
+        void declare_variable(word_t word) {
+            if (variables_count == size()) {
+                throw TooManyVariablesException();
             }
-        };
+            OOASM_PROBE(probe.declared();)
+            set(variables_count, word);
+        }
 
-        class TooManyVariablesException : public std::exception {
-            [[nodiscard]] const char *what() const noexcept override {
-                return "Too many variable declarations!";
+        static address_t variable_address(const IdTable::value_t *address) {
+            if (address == nullptr) {
+                throw std::out_of_range("Undeclared variable");
             }
-        };
+            return *address;
+        }
 
-        using mem_t = word_t[];
         mem_size_t _size;
         mem_size_t variables_count = 0;
-        std::unique_ptr<mem_t> mem;
-        std::unordered_map<id_t, mem_size_t> vars;
+        // Snapshots change only how words are stored, not words themselves.
+        mutable BasicStorage<Word> mem;
+        IdTable vars;
+        OOASM_PROBE(mutable Instrumentation probe;)
+    };
+
+    using Memory = BasicMemory<int64_t>;
+
+    // Boot image of program, worked out by its first boot and restored by later ones on
+    // computers of any size it fits in, which share it read-only. Copies of program share it.
+    class BootImageCache {
+    public:
+        using image_ptr = std::shared_ptr<const Memory::BootImage>;
+
+        [[nodiscard]] image_ptr get() const {
+            std::lock_guard<std::mutex> guard(lock);
+            return image;
+        }
+
+        void set(image_ptr _image) {
+            std::lock_guard<std::mutex> guard(lock);
+            image = std::move(_image);
+        }
 
+    private:
+        mutable std::mutex lock;
+        image_ptr image;
     };
 
     // Base class for processor, introduced in order to avoid circular file dependency.
-    class ProcessorAbstract {
+    // Flags are lazy: arithmetic records its result and flags are worked out of it only once
+    // asked for, as most of them are overwritten before any onez or ones reads them.
+    template <typename Word>
+    class BasicProcessorAbstract {
     public:
         using flag_t = bool;
 
         [[nodiscard]] flag_t getZF() const {
+            settle();
             return ZF;
         }
 
         [[nodiscard]] flag_t getSF() const {
+            settle();
             return SF;
         }
 
         void setZF(flag_t new_val) {
+            settle();
             ZF = new_val;
         }
 
         void setSF(flag_t new_val) {
+            settle();
             SF = new_val;
         }
 
+        // Sets flags as result of arithmetic operation does.
+        void set_result(Word res) {
+            result = res;
+            pending = true;
+        }
+
     protected:
-        flag_t ZF, SF;
-        Memory &mem;
+        BasicMemory<Word> &mem;
 
-        explicit ProcessorAbstract(Memory &memory)
-                : ZF(false), SF(false), mem(memory) {}
+        explicit BasicProcessorAbstract(BasicMemory<Word> &memory) : mem(memory) {}
 
+    private:
+        // Works out flags of result recorded since they were last set.
+        void settle() const {
+            if (pending) {
+                ZF = WordArithmetic<Word>::zero(result);
+                SF = WordArithmetic<Word>::sign(result);
+                pending = false;
+            }
+        }
+
+        mutable flag_t ZF = false;
+        mutable flag_t SF = false;
+        mutable bool pending = false;
+        Word result = 0;
     };
+
+    using ProcessorAbstract = BasicProcessorAbstract<int64_t>;
 }
 
 #endif //JNP1_6_COMPUTER_COMPONENTS_H
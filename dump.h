@@ -0,0 +1,132 @@
+#ifndef JNP1_6_DUMP_H
+#define JNP1_6_DUMP_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "computer_components.h"
+
+// Dumping memory in text and binary form and comparing memories.
+namespace computer {
+    // Addresses [begin, end) whose words differ between two memories.
+    struct Range {
+        Memory::address_t begin;
+        Memory::address_t end;
+
+        bool operator==(const Range &other) const {
+            return begin == other.begin && end == other.end;
+        }
+    };
+
+    // Writes words as signed decimal numbers each followed by space, formatting them into
+    // large buffers instead of going through operator<< word by word.
+    template <typename Word>
+    void dump_text(const Word *words, Memory::mem_size_t size, std::ostream &os) {
+        constexpr size_t buffer_size = 1 << 16;
+        constexpr size_t max_word = 21;
+        std::vector<char> buffer(buffer_size);
+        char *end = buffer.data() + buffer_size;
+        char *out = buffer.data();
+        for (Memory::mem_size_t i = 0; i < size; ++i) {
+            if (end - out < static_cast<std::ptrdiff_t>(max_word)) {
+                os.write(buffer.data(), out - buffer.data());
+                out = buffer.data();
+            }
+            out = std::to_chars(out, end, static_cast<long long>(words[i])).ptr;
+            *out++ = ' ';
+        }
+        os.write(buffer.data(), out - buffer.data());
+    }
+
+    // Writes words as they are kept in memory: native byte order, no header.
+    template <typename Word>
+    void dump_binary(const Word *words, Memory::mem_size_t size, std::ostream &os) {
+        os.write(reinterpret_cast<const char *>(words),
+                 static_cast<std::streamsize>(size * sizeof(Word)));
+    }
+
+    // Compares words of memories from address <offset> on, appending differing ranges and
+    // extending last range of <ranges> when it ends where new one begins. Blocks of words are
+    // skipped with memcmp, which the standard library vectorizes, and only blocks that differ
+    // are scanned word by word.
+    template <typename Word>
+    void diff_words(const Word *a, const Word *b, Memory::mem_size_t size,
+                    Memory::address_t offset, std::vector<Range> &ranges) {
+        constexpr Memory::mem_size_t block = 512;
+        for (Memory::mem_size_t begin = 0; begin < size; begin += block) {
+            Memory::mem_size_t end = std::min(size, begin + block);
+            if (std::memcmp(a + begin, b + begin, (end - begin) * sizeof(Word)) == 0) {
+                continue;
+            }
+            for (Memory::mem_size_t i = begin; i < end; ++i) {
+                if (a[i] == b[i]) {
+                    continue;
+                }
+                Memory::address_t at = offset + i;
+                if (!ranges.empty() && ranges.back().end == at) {
+                    ranges.back().end = at + 1;
+                } else {
+                    ranges.push_back({at, at + 1});
+                }
+            }
+        }
+    }
+
+    // Words present in only one of memories of different sizes count as differing.
+    inline void diff_tail(Memory::mem_size_t common, Memory::mem_size_t size,
+                          std::vector<Range> &ranges) {
+        if (common == size) {
+            return;
+        }
+        if (!ranges.empty() && ranges.back().end == common) {
+            ranges.back().end = size;
+        } else {
+            ranges.push_back({common, size});
+        }
+    }
+
+    template <typename Word>
+    std::vector<Range> diff(const Word *a, Memory::mem_size_t a_size, const Word *b,
+                            Memory::mem_size_t b_size) {
+        std::vector<Range> ranges;
+        Memory::mem_size_t common = std::min(a_size, b_size);
+        diff_words(a, b, common, 0, ranges);
+        diff_tail(common, std::max(a_size, b_size), ranges);
+        return ranges;
+    }
+
+    // Compares memory with binary dump read from stream in chunks. Bytes at the end of dump
+    // which do not make up a whole word count as a differing word.
+    template <typename Word>
+    std::vector<Range> diff(const Word *words, Memory::mem_size_t size, std::istream &is) {
+        constexpr Memory::mem_size_t chunk = 1 << 13;
+        std::vector<Range> ranges;
+        std::vector<Word> buffer(chunk);
+        Memory::mem_size_t read = 0;
+        while (is) {
+            is.read(reinterpret_cast<char *>(buffer.data()),
+                    static_cast<std::streamsize>(chunk * sizeof(Word)));
+            auto count = static_cast<Memory::mem_size_t>(is.gcount()) / sizeof(Word);
+            if (read < size) {
+                diff_words(words + read, buffer.data(), std::min(count, size - read), read,
+                           ranges);
+            }
+            read += count;
+            if (static_cast<size_t>(is.gcount()) % sizeof(Word) != 0) {
+                // Word cut short by end of dump differs from any word of memory.
+                if (read < size) {
+                    diff_tail(read, read + 1, ranges);
+                }
+                ++read;
+            }
+        }
+        Memory::mem_size_t common = std::min(read, size);
+        diff_tail(common, std::max(read, size), ranges);
+        return ranges;
+    }
+}
+
+#endif //JNP1_6_DUMP_H
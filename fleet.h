@@ -0,0 +1,95 @@
+#ifndef JNP1_6_FLEET_H
+#define JNP1_6_FLEET_H
+
+#include <deque>
+#include <exception>
+#include <vector>
+#include "computer.h"
+#include "thread_pool.h"
+
+namespace computer {
+    // Group of independent computers of equal memory size, booting or running the same
+    // program in parallel. Program is compiled and verified once and shared read-only, while every
+    // computer keeps its own memory and processor.
+    class ComputerFleet {
+    public:
+        using errors_t = std::vector<std::exception_ptr>;
+
+        ComputerFleet(size_t count, size_t mem_size,
+                      size_t threads = std::thread::hardware_concurrency())
+                : pool(threads) {
+            for (size_t i = 0; i < count; ++i) {
+                computers.emplace_back(mem_size);
+            }
+        }
+
+        // Boots program on every computer. Exception thrown by one of them does not stop the
+        // others, it is reported at its index of returned vector, which is null on success.
+        errors_t boot(const ooasm::Program &p) {
+            Bytecode code(p);
+            if (!computers.empty()) {
+                ooasm::verify(code, computers.front().computer.memory_size());
+            }
+            return boot(code);
+        }
+
+        errors_t boot(const Bytecode &code) {
+            errors_t errors(size());
+            pool.parallel_for(size(), pool.default_grain(size()), [&](size_t i) {
+                try {
+                    computers[i].computer.boot(code);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+            return errors;
+        }
+
+        // Continues program on every computer from state it is in, without wiping memory, so
+        // that the same program runs from many initial states, e.g. restored from snapshots.
+        // Errors are reported as by boot.
+        errors_t run(const ooasm::Program &p) {
+            return run(Bytecode(p));
+        }
+
+        errors_t run(const Bytecode &code) {
+            errors_t errors(size());
+            pool.parallel_for(size(), pool.default_grain(size()), [&](size_t i) {
+                try {
+                    computers[i].computer.run(code);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+            return errors;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return computers.size();
+        }
+
+        [[nodiscard]] Computer &operator[](size_t i) {
+            return computers[i].computer;
+        }
+
+        [[nodiscard]] const Computer &operator[](size_t i) const {
+            return computers[i].computer;
+        }
+
+    private:
+        // Computers booted by different workers are kept in separate cache lines, so that
+        // updates of their flags do not contend.
+        struct alignas(64) Slot {
+            explicit Slot(size_t mem_size) : computer(mem_size) {}
+
+            Computer computer;
+        };
+
+        std::deque<Slot> computers;
+        ThreadPool pool;
+    };
+}
+
+using computer::ComputerFleet;
+
+#endif //JNP1_6_FLEET_H
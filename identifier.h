@@ -0,0 +1,183 @@
+#ifndef JNP1_6_IDENTIFIER_H
+#define JNP1_6_IDENTIFIER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace computer {
+    // Identifier of at most 15 characters packed into 16 bytes: length in the first byte,
+    // characters after it and zeros up to the end, so that equal identifiers have equal keys
+    // and comparing them takes a single vector comparison.
+    struct alignas(16) PackedId {
+        constexpr static size_t MAX_LENGTH = 15;
+
+        uint64_t words[2] = {0, 0};
+
+        PackedId() = default;
+
+        // Identifier has to fit, see fits().
+        explicit PackedId(std::string_view id) {
+            unsigned char bytes[16] = {};
+            bytes[0] = static_cast<unsigned char>(id.size());
+            std::memcpy(bytes + 1, id.data(), id.size());
+            std::memcpy(words, bytes, sizeof(words));
+        }
+
+        // Empty identifier is not packed, as its key would be that of empty slot of IdTable.
+        [[nodiscard]] static bool fits(std::string_view id) {
+            return !id.empty() && id.size() <= MAX_LENGTH;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return (words[0] | words[1]) == 0;
+        }
+
+        [[nodiscard]] std::string str() const {
+            const auto *bytes = reinterpret_cast<const char *>(words);
+            return std::string(bytes + 1, static_cast<unsigned char>(bytes[0]));
+        }
+
+        bool operator==(const PackedId &other) const {
+#ifdef __SSE2__
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(words));
+            __m128i b = _mm_load_si128(reinterpret_cast<const __m128i *>(other.words));
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xffff;
+#else
+            return words[0] == other.words[0] && words[1] == other.words[1];
+#endif
+        }
+
+        // Every bit of key affects every bit of hash, so that slots taken by identifiers
+        // differing only in their last characters are spread.
+        [[nodiscard]] uint64_t hash() const {
+            uint64_t h = words[0] ^ words[1] * 0x9e3779b97f4a7c15ULL;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            return h ^ h >> 33;
+        }
+    };
+
+    // Map from identifiers to integers: flat open-addressing table of packed keys with linear
+    // probing, kept at most half full. Identifiers which do not pack, which ooasm::ID never
+    // produces, are kept aside in a node-based map.
+    class IdTable {
+    public:
+        using value_t = uint64_t;
+
+        [[nodiscard]] const value_t *find(const PackedId &key) const {
+            if (keys.empty()) {
+                return nullptr;
+            }
+            size_t slot = probe(key);
+            return keys[slot].empty() ? nullptr : &values[slot];
+        }
+
+        [[nodiscard]] const value_t *find(std::string_view id) const {
+            if (PackedId::fits(id)) {
+                return find(PackedId(id));
+            }
+            auto it = others.find(std::string(id));
+            return it == others.end() ? nullptr : &it->second;
+        }
+
+        // Inserts value unless identifier is already there. Returns whether it was inserted.
+        // Table grows only for identifiers which are not there yet.
+        bool try_emplace(const PackedId &key, value_t value) {
+            size_t slot = 0;
+            if (!keys.empty()) {
+                slot = probe(key);
+                if (!keys[slot].empty()) {
+                    return false;
+                }
+            }
+            if (2 * (packed + 1) > keys.size()) {
+                grow();
+                slot = probe(key);
+            }
+            keys[slot] = key;
+            values[slot] = value;
+            packed++;
+            return true;
+        }
+
+        bool try_emplace(std::string_view id, value_t value) {
+            if (PackedId::fits(id)) {
+                return try_emplace(PackedId(id), value);
+            }
+            return others.try_emplace(std::string(id), value).second;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return packed + others.size();
+        }
+
+        // Forgets identifiers, keeping allocated slots.
+        void clear() {
+            if (packed > 0) {
+                std::fill(keys.begin(), keys.end(), PackedId());
+                packed = 0;
+            }
+            others.clear();
+        }
+
+        // Calls <function> with every identifier, as string, and its value.
+        template <typename Function>
+        void for_each(Function function) const {
+            for (size_t slot = 0; slot < keys.size(); ++slot) {
+                if (!keys[slot].empty()) {
+                    function(keys[slot].str(), values[slot]);
+                }
+            }
+            for (const auto &[id, value] : others) {
+                function(id, value);
+            }
+        }
+
+    private:
+        constexpr static size_t INITIAL_SLOTS = 16;
+
+        [[nodiscard]] size_t mask() const {
+            return keys.size() - 1;
+        }
+
+        // Slot of key, or empty slot in which it would be inserted. Table has to have slots.
+        [[nodiscard]] size_t probe(const PackedId &key) const {
+            size_t slot = key.hash() & mask();
+            while (!keys[slot].empty() && !(keys[slot] == key)) {
+                slot = (slot + 1) & mask();
+            }
+            return slot;
+        }
+
+        void grow() {
+            std::vector<PackedId> old_keys(std::max(INITIAL_SLOTS, 2 * keys.size()));
+            std::vector<value_t> old_values(old_keys.size());
+            old_keys.swap(keys);
+            old_values.swap(values);
+            packed = 0;
+            for (size_t slot = 0; slot < old_keys.size(); ++slot) {
+                if (!old_keys[slot].empty()) {
+                    try_emplace(old_keys[slot], old_values[slot]);
+                }
+            }
+        }
+
+        std::vector<PackedId> keys;
+        std::vector<value_t> values;
+        size_t packed = 0;
+        std::unordered_map<std::string, value_t> others;
+    };
+}
+
+#endif //JNP1_6_IDENTIFIER_H
@@ -0,0 +1,339 @@
+#ifndef JNP1_6_INCREMENTAL_H
+#define JNP1_6_INCREMENTAL_H
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "computer.h"
+
+namespace computer {
+    // Computer booting program which is being edited, e.g. by interactive tooling. Program is
+    // kept as instructions together with bytecode compiled from them, which edits update in
+    // place. Boots keep checkpoints of memory and flags every <interval> ops, so that boot after
+    // edits restarts from the last checkpoint before the first op edited, and stops as soon as
+    // state at a checkpoint of the previous boot past the edits turns out to be the same, as
+    // the rest of program then runs the same. Checkpoints are copies of whole memory, so it is
+    // meant for memories small enough to copy often.
+    class IncrementalComputer {
+    public:
+        using instruction_ptr = std::shared_ptr<Instruction>;
+
+        IncrementalComputer(size_t mem_size, const ooasm::Program &program,
+                            size_t _interval = DEFAULT_INTERVAL)
+                : interval(std::max<size_t>(_interval, 1)), mem(mem_size), proc(mem) {
+            rebuild(std::vector<instruction_ptr>(program.begin(), program.end()));
+        }
+
+        // Processor refers to memory of computer, so it cannot be copied or moved.
+        IncrementalComputer(const IncrementalComputer &) = delete;
+
+        IncrementalComputer &operator=(const IncrementalComputer &) = delete;
+
+        [[nodiscard]] size_t size() const {
+            return instructions.size();
+        }
+
+        [[nodiscard]] const instruction_ptr &instruction(size_t position) const {
+            return instructions[position];
+        }
+
+        // Edits take effect on the next boot. Edit of declarations restarts it from scratch, as
+        // addresses of variables may change. Edit referring to undeclared variable throws, as
+        // linking program does, and leaves program as it was.
+        void insert(size_t position, instruction_ptr ins) {
+            if (!ins->kind()) {
+                std::vector<instruction_ptr> edited = instructions;
+                edited.insert(edited.begin() + static_cast<std::ptrdiff_t>(position),
+                              std::move(ins));
+                rebuild(std::move(edited));
+                return;
+            }
+            Bytecode::Op op = compile(*ins);
+            size_t at = op_index(position);
+            std::vector<Bytecode::Op> &ops = code.mutable_code();
+            ops.insert(ops.begin() + static_cast<std::ptrdiff_t>(at), op);
+            instructions.insert(instructions.begin() + static_cast<std::ptrdiff_t>(position),
+                                std::move(ins));
+            shift_declarations(position, 1);
+            changed(at, 0, 1);
+        }
+
+        void erase(size_t position) {
+            if (declaration(position)) {
+                std::vector<instruction_ptr> edited = instructions;
+                edited.erase(edited.begin() + static_cast<std::ptrdiff_t>(position));
+                rebuild(std::move(edited));
+                return;
+            }
+            size_t at = op_index(position);
+            std::vector<Bytecode::Op> &ops = code.mutable_code();
+            ops.erase(ops.begin() + static_cast<std::ptrdiff_t>(at));
+            instructions.erase(instructions.begin() + static_cast<std::ptrdiff_t>(position));
+            shift_declarations(position, -1);
+            changed(at, 1, 0);
+        }
+
+        // Replaces instruction, e.g. with one whose operand is changed.
+        void replace(size_t position, instruction_ptr ins) {
+            if (declaration(position) || !ins->kind()) {
+                std::vector<instruction_ptr> edited = instructions;
+                edited[position] = std::move(ins);
+                rebuild(std::move(edited));
+                return;
+            }
+            Bytecode::Op op = compile(*ins);
+            size_t at = op_index(position);
+            code.mutable_code()[at] = op;
+            instructions[position] = std::move(ins);
+            changed(at, 1, 1);
+        }
+
+        // Brings memory and flags into state in which boot of program as edited so far leaves
+        // new computer, rethrowing exception which stopped it.
+        void boot() {
+            if (fresh) {
+                run_from_start();
+            } else if (dirty) {
+                rerun();
+            }
+            fresh = dirty = false;
+            if (fault) {
+                std::rethrow_exception(fault);
+            }
+        }
+
+        [[nodiscard]] const Bytecode &bytecode() const {
+            return code;
+        }
+
+        [[nodiscard]] size_t memory_size() const {
+            return mem.size();
+        }
+
+        void memory_dump(std::ostream &os) const {
+            dump_text(mem.data(), mem.size(), os);
+        }
+
+        void memory_dump_binary(std::ostream &os) const {
+            dump_binary(mem.data(), mem.size(), os);
+        }
+
+        [[nodiscard]] Snapshot snapshot() const {
+            return {mem.snapshot(), proc.getZF(), proc.getSF()};
+        }
+
+    private:
+        constexpr static size_t DEFAULT_INTERVAL = 4096;
+
+        // State of memory and flags right before op at <position>.
+        struct Checkpoint {
+            size_t position;
+            std::vector<Memory::word_t> words;
+            ProcessorAbstract::flag_t ZF;
+            ProcessorAbstract::flag_t SF;
+        };
+
+        // Recompiles whole program, whose declarations changed.
+        void rebuild(std::vector<instruction_ptr> edited) {
+            Bytecode compiled;
+            for (const instruction_ptr &ins : edited) {
+                ins->compile(compiled);
+            }
+            compiled.link();
+            ooasm::Linker declared;
+            for (const Bytecode::Decl &decl : compiled.declarations()) {
+                declared.declare(compiled.name(decl.name));
+            }
+            code = std::move(compiled);
+            linker = std::move(declared);
+            instructions = std::move(edited);
+            declarations.clear();
+            for (size_t position = 0; position < instructions.size(); ++position) {
+                if (!instructions[position]->kind()) {
+                    declarations.push_back(position);
+                }
+            }
+            fresh = true;
+        }
+
+        // Op of instruction which is not declaration, linked against declarations of program.
+        [[nodiscard]] Bytecode::Op compile(const Instruction &ins) const {
+            Bytecode single;
+            ins.compile(single);
+            Bytecode::Op op = single.code()[0];
+            for (Bytecode::Operand *operand : {&op.dst, &op.src}) {
+                if (operand->mode == Bytecode::Mode::Var) {
+                    operand->value = static_cast<Bytecode::word_t>(
+                            linker.resolve(single.name(operand->value)));
+                    operand->mode = Bytecode::Mode::Imm;
+                }
+            }
+            return op;
+        }
+
+        [[nodiscard]] bool declaration(size_t position) const {
+            return std::binary_search(declarations.begin(), declarations.end(), position);
+        }
+
+        // Index of op of instruction at <position>, or of the first one after it.
+        [[nodiscard]] size_t op_index(size_t position) const {
+            auto before = std::lower_bound(declarations.begin(), declarations.end(), position);
+            return position - static_cast<size_t>(before - declarations.begin());
+        }
+
+        // Moves declarations at <position> and after it by <offset>, after instruction which
+        // is not declaration was inserted or erased there.
+        void shift_declarations(size_t position, std::ptrdiff_t offset) {
+            auto first = std::lower_bound(declarations.begin(), declarations.end(), position);
+            for (auto it = first; it != declarations.end(); ++it) {
+                *it = static_cast<size_t>(static_cast<std::ptrdiff_t>(*it) + offset);
+            }
+        }
+
+        // Records that <removed> ops at <at> were replaced by <inserted> ones. Ops in
+        // [changed_begin, changed_end) may differ from those which the last boot ran, and ops
+        // from changed_end on are those it ran, shifted by <shift>.
+        void changed(size_t at, size_t removed, size_t inserted) {
+            if (!dirty) {
+                dirty = true;
+                changed_begin = at;
+                changed_end = at + inserted;
+                shift = 0;
+            } else {
+                changed_begin = std::min(changed_begin, at);
+                changed_end = changed_end > at && changed_end >= at + removed
+                              ? changed_end - removed + inserted : at + inserted;
+            }
+            shift += static_cast<std::ptrdiff_t>(inserted) - static_cast<std::ptrdiff_t>(removed);
+        }
+
+        void run_from_start() {
+            checkpoints.clear();
+            fault = nullptr;
+            mem.wipe();
+            proc.setZF(false);
+            proc.setSF(false);
+            try {
+                proc.declare(code);
+            } catch (...) {
+                fault = std::current_exception();
+                return;
+            }
+            checkpoints.push_back(capture(0));
+            execute(0, {}, nullptr);
+        }
+
+        void rerun() {
+            if (checkpoints.empty()) {
+                // Declarations, which edits did not change, failed.
+                return;
+            }
+            // Checkpoints up to the first op edited hold, those at ops which were not edited
+            // are where execution may converge with the previous one.
+            auto after = std::upper_bound(checkpoints.begin(), checkpoints.end(), changed_begin,
+                                          [](size_t position, const Checkpoint &checkpoint) {
+                                              return position < checkpoint.position;
+                                          });
+            auto tail = std::find_if(after, checkpoints.end(), [this](const Checkpoint &c) {
+                return static_cast<std::ptrdiff_t>(c.position) + shift >=
+                       static_cast<std::ptrdiff_t>(changed_end);
+            });
+            std::vector<Checkpoint> comparable(std::make_move_iterator(tail),
+                                               std::make_move_iterator(checkpoints.end()));
+            for (Checkpoint &checkpoint : comparable) {
+                checkpoint.position = static_cast<size_t>(
+                        static_cast<std::ptrdiff_t>(checkpoint.position) + shift);
+            }
+            checkpoints.erase(after, checkpoints.end());
+
+            std::unique_ptr<Checkpoint> previous;
+            if (!comparable.empty()) {
+                previous = std::make_unique<Checkpoint>(capture(code.code().size()));
+            }
+            std::exception_ptr previous_fault = std::exchange(fault, nullptr);
+            restore(checkpoints.back());
+            if (execute(checkpoints.back().position, std::move(comparable), previous.get())) {
+                fault = previous_fault;
+            }
+        }
+
+        // Runs ops from <position> on, taking checkpoints. On reaching position of one of
+        // <comparable> checkpoints in the same state, puts memory in <previous> state, which
+        // the rest of program leads to, and returns true.
+        bool execute(size_t position, std::vector<Checkpoint> comparable,
+                     const Checkpoint *previous) {
+            size_t size = code.code().size();
+            size_t last = position;
+            auto next = comparable.begin();
+            while (position < size) {
+                size_t stop = std::min(size, last + interval);
+                if (next != comparable.end()) {
+                    stop = std::min(stop, next->position);
+                }
+                try {
+                    proc.run(code, position, stop);
+                } catch (...) {
+                    fault = std::current_exception();
+                    return false;
+                }
+                position = stop;
+                if (next != comparable.end() && next->position == position) {
+                    if (same(*next)) {
+                        restore(*previous);
+                        checkpoints.insert(checkpoints.end(), std::make_move_iterator(next),
+                                           std::make_move_iterator(comparable.end()));
+                        return true;
+                    }
+                    std::copy_n(mem.data(), mem.size(), next->words.data());
+                    next->ZF = proc.getZF();
+                    next->SF = proc.getSF();
+                    checkpoints.push_back(std::move(*next++));
+                    last = position;
+                } else if (position == last + interval && position < size) {
+                    checkpoints.push_back(capture(position));
+                    last = position;
+                }
+            }
+            return false;
+        }
+
+        [[nodiscard]] Checkpoint capture(size_t position) const {
+            return {position, {mem.data(), mem.data() + mem.size()}, proc.getZF(), proc.getSF()};
+        }
+
+        void restore(const Checkpoint &checkpoint) {
+            std::copy(checkpoint.words.begin(), checkpoint.words.end(), mem.data());
+            proc.setZF(checkpoint.ZF);
+            proc.setSF(checkpoint.SF);
+        }
+
+        [[nodiscard]] bool same(const Checkpoint &checkpoint) const {
+            return proc.getZF() == checkpoint.ZF && proc.getSF() == checkpoint.SF &&
+                   std::memcmp(mem.data(), checkpoint.words.data(),
+                               mem.size() * sizeof(Memory::word_t)) == 0;
+        }
+
+        size_t interval;
+        Memory mem;
+        Processor proc;
+        std::vector<instruction_ptr> instructions;
+        // Positions of instructions which are declarations rather than ops, which are few.
+        std::vector<size_t> declarations;
+        Bytecode code;
+        ooasm::Linker linker;
+        std::vector<Checkpoint> checkpoints;
+        std::exception_ptr fault;
+        bool fresh = true;
+        bool dirty = false;
+        size_t changed_begin = 0;
+        size_t changed_end = 0;
+        std::ptrdiff_t shift = 0;
+    };
+}
+
+using computer::IncrementalComputer;
+
+#endif //JNP1_6_INCREMENTAL_H
@@ -1,7 +1,10 @@
 #ifndef JNP1_6_INSTRUCTION_H
 #define JNP1_6_INSTRUCTION_H
 
+#include <optional>
 #include "computer_components.h"
+#include "bytecode.h"
+#include "linker.h"
 
 namespace ooasm {
     using computer::ProcessorAbstract;
@@ -15,6 +18,21 @@ namespace ooasm {
         virtual void execute(ProcessorAbstract &, Memory &) const = 0;
 
         virtual void declare(Memory &) const {};
+
+        // Registers variables declared by instruction, so that program can be linked.
+        virtual void declare(Linker &) const {};
+
+        // Binds identifiers used by instruction to addresses of variables.
+        virtual void link(const Linker &) {};
+
+        // Appends flat representation of instruction to given bytecode.
+        virtual void compile(Bytecode &) const = 0;
+
+        // Bytecode counterpart of executed instruction, classifying it in statistics of
+        // execution. None for declarations, which execute nothing.
+        [[nodiscard]] virtual std::optional<Bytecode::Opcode> kind() const {
+            return std::nullopt;
+        }
     };
 }
 
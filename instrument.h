@@ -0,0 +1,337 @@
+#ifndef JNP1_6_INSTRUMENT_H
+#define JNP1_6_INSTRUMENT_H
+
+// Statistics of execution are collected only when compiled with OOASM_INSTRUMENT defined to 1
+// (CMake option of the same name). Otherwise probes expand to nothing and cost nothing.
+#ifndef OOASM_INSTRUMENT
+#define OOASM_INSTRUMENT 0
+#endif
+
+#if OOASM_INSTRUMENT
+#define OOASM_PROBE(...) __VA_ARGS__
+#else
+#define OOASM_PROBE(...)
+#endif
+
+#if OOASM_INSTRUMENT
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "identifier.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(__linux__)
+#define OOASM_PERF_EVENTS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define OOASM_PERF_EVENTS 0
+#endif
+
+namespace computer {
+    // Hardware counters of calling thread read with perf_event_open. Counters the kernel or
+    // machine does not provide (e.g. in virtual machines) are left out.
+    class PerfCounters {
+    public:
+        constexpr static size_t EVENTS = 3;
+        constexpr static std::array<const char *, EVENTS> NAMES = {
+                "cycles", "branch_misses", "cache_misses"};
+
+        PerfCounters() {
+#if OOASM_PERF_EVENTS
+            constexpr std::array<uint64_t, EVENTS> configs = {
+                    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_BRANCH_MISSES,
+                    PERF_COUNT_HW_CACHE_MISSES};
+            for (size_t i = 0; i < EVENTS; ++i) {
+                perf_event_attr attr{};
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.size = sizeof(attr);
+                attr.config = configs[i];
+                attr.disabled = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                                                  PERF_FLAG_FD_CLOEXEC));
+            }
+#endif
+        }
+
+        PerfCounters(const PerfCounters &) = delete;
+
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        ~PerfCounters() {
+#if OOASM_PERF_EVENTS
+            for (int fd : fds) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+#endif
+        }
+
+        [[nodiscard]] bool available() const {
+            return std::any_of(fds.begin(), fds.end(), [](int fd) { return fd >= 0; });
+        }
+
+        void start() {
+#if OOASM_PERF_EVENTS
+            for (int fd : fds) {
+                if (fd >= 0) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+#endif
+        }
+
+        // Stops counting, adding counts since start to totals.
+        void stop() {
+#if OOASM_PERF_EVENTS
+            for (size_t i = 0; i < EVENTS; ++i) {
+                uint64_t count = 0;
+                if (fds[i] >= 0) {
+                    ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+                    if (read(fds[i], &count, sizeof(count)) == sizeof(count)) {
+                        totals[i] = totals[i].value_or(0) + count;
+                    }
+                }
+            }
+#endif
+        }
+
+        // Total of event, if it could be counted.
+        [[nodiscard]] std::optional<uint64_t> total(size_t event) const {
+            return totals[event];
+        }
+
+    private:
+        std::array<int, EVENTS> fds = {-1, -1, -1};
+        std::array<std::optional<uint64_t>, EVENTS> totals;
+    };
+
+    // Statistics of execution on memory of computer, accumulated over boots: executions and
+    // cycles spent by each class of instruction, reads and writes of every address, lookups of
+    // variables by name and accesses out of range. Linking binds nearly every lea to address of
+    // its variable, so only lea shared by programs declaring its variable at different
+    // addresses looks it up, and lookups count those rather than all evaluations of lea.
+    // Native code of JitProgram, image copied in by PartialProgram and parallel segments of
+    // ParallelProgram bypass memory accessors, so of them only boots are recorded.
+    class Instrumentation {
+    public:
+        using address_t = uint64_t;
+
+        // Classes of instructions in order of ooasm::Bytecode::Opcode.
+        constexpr static size_t CLASSES = 6;
+        constexpr static std::array<const char *, CLASSES> CLASS_NAMES = {
+                "mov", "add", "sub", "one", "onez", "ones"};
+
+        struct Heat {
+            uint64_t reads = 0;
+            uint64_t writes = 0;
+        };
+
+        // Records boot lasting as long as the object, with hardware counters if enabled.
+        class Boot {
+        public:
+            explicit Boot(Instrumentation &_probe)
+                    : probe(_probe), start(std::chrono::steady_clock::now()) {
+                if (probe.perf) {
+                    probe.perf->start();
+                }
+            }
+
+            Boot(const Boot &) = delete;
+
+            Boot &operator=(const Boot &) = delete;
+
+            ~Boot() {
+                if (probe.perf) {
+                    probe.perf->stop();
+                }
+                std::chrono::duration<double, std::nano> time =
+                        std::chrono::steady_clock::now() - start;
+                probe.boots++;
+                probe.boot_ns += static_cast<uint64_t>(time.count());
+            }
+
+        private:
+            Instrumentation &probe;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        // Timestamp for measuring cycles spent by instructions: time stamp counter where
+        // available, nanoseconds elsewhere.
+        static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+        }
+
+        // Starts reading hardware counters around boots. Returns whether any is available.
+        bool enable_perf() {
+            if (!perf) {
+                perf = std::make_unique<PerfCounters>();
+            }
+            return perf->available();
+        }
+
+        void executed(size_t instruction_class, uint64_t spent) {
+            executions[instruction_class]++;
+            spent_cycles[instruction_class] += spent;
+        }
+
+        void read(address_t i) {
+            heat[i].reads++;
+        }
+
+        void written(address_t i) {
+            heat[i].writes++;
+        }
+
+        void declared() {
+            declarations++;
+        }
+
+        void looked_up() {
+            dynamic_lea_lookups++;
+        }
+
+        void out_of_range() {
+            out_of_range_accesses++;
+        }
+
+        [[nodiscard]] uint64_t executions_of(size_t instruction_class) const {
+            return executions[instruction_class];
+        }
+
+        [[nodiscard]] uint64_t cycles_of(size_t instruction_class) const {
+            return spent_cycles[instruction_class];
+        }
+
+        [[nodiscard]] const std::unordered_map<address_t, Heat> &heatmap() const {
+            return heat;
+        }
+
+        [[nodiscard]] uint64_t dynamic_lookups() const {
+            return dynamic_lea_lookups;
+        }
+
+        [[nodiscard]] uint64_t out_of_range_count() const {
+            return out_of_range_accesses;
+        }
+
+        // Forgets statistics, keeping hardware counters enabled.
+        void reset() {
+            bool had_perf = perf != nullptr;
+            perf.reset();
+            *this = Instrumentation();
+            if (had_perf) {
+                enable_perf();
+            }
+        }
+
+        // Writes statistics as JSON object. Heat of variables is that of addresses they are
+        // declared at by <variables>, usually those of the last boot.
+        void write_json(std::ostream &os, const IdTable &variables) const {
+            os << "{\n  \"boots\": " << boots << ",\n  \"boot_ns\": " << boot_ns
+               << ",\n  \"declarations\": " << declarations
+               << ",\n  \"dynamic_lea_lookups\": " << dynamic_lea_lookups
+               << ",\n  \"out_of_range\": " << out_of_range_accesses
+               << ",\n  \"instructions\": {";
+            for (size_t i = 0; i < CLASSES; ++i) {
+                os << (i > 0 ? ",\n" : "\n") << "    \"" << CLASS_NAMES[i] << "\": {\"count\": "
+                   << executions[i] << ", \"cycles\": " << spent_cycles[i] << "}";
+            }
+            os << "\n  },\n  \"addresses\": {";
+            std::vector<address_t> addresses;
+            addresses.reserve(heat.size());
+            for (const auto &entry : heat) {
+                addresses.push_back(entry.first);
+            }
+            std::sort(addresses.begin(), addresses.end());
+            for (size_t i = 0; i < addresses.size(); ++i) {
+                os << (i > 0 ? ",\n" : "\n") << "    \"" << addresses[i] << "\": ";
+                write_heat(os, heat.at(addresses[i]));
+            }
+            os << "\n  },\n  \"variables\": {";
+            std::vector<std::pair<std::string, uint64_t>> names;
+            variables.for_each([&names](const std::string &name, uint64_t address) {
+                names.emplace_back(name, address);
+            });
+            std::sort(names.begin(), names.end());
+            for (size_t i = 0; i < names.size(); ++i) {
+                auto it = heat.find(names[i].second);
+                os << (i > 0 ? ",\n" : "\n") << "    ";
+                write_string(os, names[i].first);
+                os << ": ";
+                write_heat(os, it == heat.end() ? Heat() : it->second);
+            }
+            os << "\n  }";
+            if (perf && perf->available()) {
+                os << ",\n  \"perf\": {";
+                bool first = true;
+                for (size_t i = 0; i < PerfCounters::EVENTS; ++i) {
+                    if (std::optional<uint64_t> total = perf->total(i)) {
+                        os << (first ? "" : ", ") << "\"" << PerfCounters::NAMES[i] << "\": "
+                           << *total;
+                        first = false;
+                    }
+                }
+                os << "}";
+            }
+            os << "\n}\n";
+        }
+
+    private:
+        static void write_heat(std::ostream &os, const Heat &h) {
+            os << "{\"reads\": " << h.reads << ", \"writes\": " << h.writes << "}";
+        }
+
+        static void write_string(std::ostream &os, const std::string &s) {
+            static const char *hex = "0123456789abcdef";
+            os << '"';
+            for (char c : s) {
+                auto byte = static_cast<unsigned char>(c);
+                if (c == '"' || c == '\\') {
+                    os << '\\' << c;
+                } else if (byte < 0x20) {
+                    os << "\\u00" << hex[byte >> 4] << hex[byte & 0xf];
+                } else {
+                    os << c;
+                }
+            }
+            os << '"';
+        }
+
+        uint64_t boots = 0;
+        uint64_t boot_ns = 0;
+        uint64_t declarations = 0;
+        uint64_t dynamic_lea_lookups = 0;
+        uint64_t out_of_range_accesses = 0;
+        std::array<uint64_t, CLASSES> executions{};
+        std::array<uint64_t, CLASSES> spent_cycles{};
+        std::unordered_map<address_t, Heat> heat;
+        std::unique_ptr<PerfCounters> perf;
+    };
+}
+
+#endif
+
+#endif //JNP1_6_INSTRUMENT_H
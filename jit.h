@@ -0,0 +1,333 @@
+#ifndef JNP1_6_JIT_H
+#define JNP1_6_JIT_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "bytecode.h"
+#include "computer_components.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define OOASM_JIT 1
+#include <sys/mman.h>
+#else
+#define OOASM_JIT 0
+#endif
+
+namespace computer {
+    using ooasm::Bytecode;
+
+    // Native x86-64 code compiled from bytecode for memory of given size. Base of memory and
+    // flags live in registers, static operands are folded into displacements of memory accesses
+    // and unverified accesses branch to a slow path raising the same exception as Memory::at.
+    // Flags of verified ops marked as dead are not set at all.
+    // Where native code cannot be produced (other platform, unlinked bytecode), compiled() is
+    // false and computers fall back to interpreting bytecode().
+    class JitProgram {
+    public:
+        using word_t = Memory::word_t;
+        using address_t = Memory::address_t;
+        using mem_size_t = Memory::mem_size_t;
+
+        JitProgram(Bytecode _code, mem_size_t _size) : code(std::move(_code)), _size(_size) {
+#if OOASM_JIT
+            if (compilable()) {
+                compile();
+            }
+#endif
+        }
+
+        JitProgram(const JitProgram &) = delete;
+
+        JitProgram &operator=(const JitProgram &) = delete;
+
+        ~JitProgram() {
+#if OOASM_JIT
+            if (region != nullptr) {
+                munmap(region, region_size);
+            }
+#endif
+        }
+
+        [[nodiscard]] const Bytecode &bytecode() const {
+            return code;
+        }
+
+        [[nodiscard]] bool compiled() const {
+            return function != nullptr;
+        }
+
+        [[nodiscard]] bool compiled_for(mem_size_t size) const {
+            return compiled() && size == _size;
+        }
+
+        // Size of memory program was compiled for, whether compiling succeeded or not.
+        [[nodiscard]] mem_size_t memory_size() const {
+            return _size;
+        }
+
+        // Runs native code on memory in state right after declarations of bytecode. Memory has
+        // to be of size the program was compiled for.
+        void run(Memory &memory, ProcessorAbstract &processor) const {
+            uint8_t flags[2] = {processor.getZF(), processor.getSF()};
+            uint64_t fault = function(memory.data(), memory.size(), flags);
+            processor.setZF(flags[0]);
+            processor.setSF(flags[1]);
+            if (fault != 0) {
+                throw Memory::OutOfRangeMemoryAccessException();
+            }
+        }
+
+    private:
+        // Native function: memory base, memory size and flags [ZF, SF], returning non-zero
+        // after out of range access.
+        using function_t = uint64_t (*)(word_t *, uint64_t, uint8_t *);
+
+        Bytecode code;
+        mem_size_t _size;
+        function_t function = nullptr;
+        void *region = nullptr;
+        size_t region_size = 0;
+
+#if OOASM_JIT
+        // Registers: rdi - memory base, rsi - memory size, rdx - flags, r8b - ZF, r9b - SF,
+        // rax, rcx, r10, r11 - scratch. All of them are caller-saved, so no prologue is needed.
+        std::vector<uint8_t> text;
+        std::vector<size_t> slow_path_jumps;
+
+        [[nodiscard]] bool compilable() const {
+            for (const Bytecode::Op &op : code.code()) {
+                if (op.dst.mode == Bytecode::Mode::Var || op.src.mode == Bytecode::Mode::Var) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void bytes(std::initializer_list<uint8_t> list) {
+            text.insert(text.end(), list);
+        }
+
+        void imm32(uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                text.push_back(static_cast<uint8_t>(value >> (8 * i)));
+            }
+        }
+
+        void imm64(uint64_t value) {
+            imm32(static_cast<uint32_t>(value));
+            imm32(static_cast<uint32_t>(value >> 32));
+        }
+
+        // Operand of depth 1 with verified address small enough to become displacement.
+        [[nodiscard]] bool folded(const Bytecode::Operand &operand) const {
+            return verified && operand.verified && operand.depth == 1 &&
+                   static_cast<address_t>(operand.value) <= INT32_MAX / sizeof(word_t);
+        }
+
+        [[nodiscard]] uint32_t displacement(const Bytecode::Operand &operand) const {
+            return static_cast<uint32_t>(operand.value * sizeof(word_t));
+        }
+
+        // cmp rcx, rsi; jae slow_path
+        void check_rcx() {
+            bytes({0x48, 0x39, 0xF1, 0x0F, 0x83});
+            slow_path_jumps.push_back(text.size());
+            imm32(0);
+        }
+
+        // Leaves address to which operand of non-zero depth refers in rcx.
+        void address_to_rcx(const Bytecode::Operand &operand) {
+            bool checked = !(verified && operand.verified);
+            bytes({0x48, 0xB9}); // mov rcx, imm64
+            imm64(operand.value);
+            for (Bytecode::depth_t i = 1; i < operand.depth; ++i) {
+                if (checked) {
+                    check_rcx();
+                }
+                bytes({0x48, 0x8B, 0x0C, 0xCF}); // mov rcx, [rdi + rcx * 8]
+            }
+            if (checked) {
+                check_rcx();
+            }
+        }
+
+        // Loads value of operand to rax (<to_r10> false) or r10.
+        void load(const Bytecode::Operand &operand, bool to_r10) {
+            uint8_t rex = to_r10 ? 0x4C : 0x48;
+            uint8_t reg = to_r10 ? 0x02 : 0x00;
+            if (operand.depth == 0) {
+                bytes({static_cast<uint8_t>(to_r10 ? 0x49 : 0x48),
+                       static_cast<uint8_t>(to_r10 ? 0xBA : 0xB8)}); // mov reg, imm64
+                imm64(operand.value);
+            } else if (folded(operand)) {
+                bytes({rex, 0x8B, static_cast<uint8_t>(0x87 | reg << 3)}); // mov reg, [rdi + disp]
+                imm32(displacement(operand));
+            } else {
+                address_to_rcx(operand);
+                bytes({rex, 0x8B, static_cast<uint8_t>(0x04 | reg << 3), 0xCF}); // [rdi + rcx * 8]
+            }
+        }
+
+        // Stores r10 to operand.
+        void store_r10(const Bytecode::Operand &operand) {
+            if (folded(operand)) {
+                bytes({0x4C, 0x89, 0x97}); // mov [rdi + disp], r10
+                imm32(displacement(operand));
+            } else {
+                address_to_rcx(operand);
+                bytes({0x4C, 0x89, 0x14, 0xCF}); // mov [rdi + rcx * 8], r10
+            }
+        }
+
+        void arithmetic(const Bytecode::Op &op) {
+            bool direct = folded(op.dst);
+            if (direct) {
+                load(op.dst, false);
+            } else {
+                address_to_rcx(op.dst);
+                bytes({0x49, 0x89, 0xCB}); // mov r11, rcx
+                bytes({0x48, 0x8B, 0x04, 0xCF}); // mov rax, [rdi + rcx * 8]
+            }
+            load(op.src, true);
+            if (op.code == Bytecode::Opcode::Add) {
+                bytes({0x4C, 0x01, 0xD0}); // add rax, r10
+            } else {
+                bytes({0x4C, 0x29, 0xD0}); // sub rax, r10
+            }
+            if (!(verified && op.flags_dead)) {
+                bytes({0x41, 0x0F, 0x94, 0xC0}); // sete r8b
+                bytes({0x41, 0x0F, 0x98, 0xC1}); // sets r9b
+            }
+            if (direct) {
+                bytes({0x48, 0x89, 0x87}); // mov [rdi + disp], rax
+                imm32(displacement(op.dst));
+            } else {
+                bytes({0x4A, 0x89, 0x04, 0xDF}); // mov [rdi + r11 * 8], rax
+            }
+        }
+
+        void one(const Bytecode::Operand &operand) {
+            if (folded(operand)) {
+                bytes({0x48, 0xC7, 0x87}); // mov qword [rdi + disp], imm32
+                imm32(displacement(operand));
+            } else {
+                address_to_rcx(operand);
+                bytes({0x48, 0xC7, 0x04, 0xCF}); // mov qword [rdi + rcx * 8], imm32
+            }
+            imm32(1);
+        }
+
+        // Sets 1 at operand if flag held in r8b (<zero> true) or r9b is set.
+        void conditional_one(const Bytecode::Operand &operand, bool zero) {
+            bytes({0x45, 0x84, static_cast<uint8_t>(zero ? 0xC0 : 0xC9)}); // test flag, flag
+            bytes({0x0F, 0x84}); // jz skip
+            size_t skip = text.size();
+            imm32(0);
+            one(operand);
+            patch(skip, text.size());
+        }
+
+        void patch(size_t at, size_t target) {
+            auto rel = static_cast<uint32_t>(target - (at + 4));
+            std::memcpy(text.data() + at, &rel, sizeof(rel));
+        }
+
+        void store_flags() {
+            bytes({0x44, 0x88, 0x02}); // mov [rdx], r8b
+            bytes({0x44, 0x88, 0x4A, 0x01}); // mov [rdx + 1], r9b
+        }
+
+        void compile() {
+            verified = code.verified_for(_size);
+            bytes({0x44, 0x0F, 0xB6, 0x02}); // movzx r8d, byte [rdx]
+            bytes({0x44, 0x0F, 0xB6, 0x4A, 0x01}); // movzx r9d, byte [rdx + 1]
+            for (const Bytecode::Op &op : code.code()) {
+                switch (op.code) {
+                    case Bytecode::Opcode::Mov:
+                        load(op.src, true);
+                        store_r10(op.dst);
+                        break;
+                    case Bytecode::Opcode::Add:
+                    case Bytecode::Opcode::Sub:
+                        arithmetic(op);
+                        break;
+                    case Bytecode::Opcode::One:
+                        one(op.dst);
+                        break;
+                    case Bytecode::Opcode::OneZ:
+                        conditional_one(op.dst, true);
+                        break;
+                    case Bytecode::Opcode::OneS:
+                        conditional_one(op.dst, false);
+                        break;
+                }
+            }
+            store_flags();
+            bytes({0x31, 0xC0, 0xC3}); // xor eax, eax; ret
+            size_t slow_path = text.size();
+            store_flags();
+            bytes({0xB8}); // mov eax, 1
+            imm32(1);
+            bytes({0xC3}); // ret
+            for (size_t jump : slow_path_jumps) {
+                patch(jump, slow_path);
+            }
+            install();
+        }
+
+        void install() {
+            region_size = text.size();
+            region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (region == MAP_FAILED) {
+                region = nullptr;
+                return;
+            }
+            std::memcpy(region, text.data(), text.size());
+            if (mprotect(region, region_size, PROT_READ | PROT_EXEC) != 0) {
+                munmap(region, region_size);
+                region = nullptr;
+                return;
+            }
+            function = reinterpret_cast<function_t>(region);
+            text = std::vector<uint8_t>();
+            slow_path_jumps = std::vector<size_t>();
+        }
+
+        bool verified = false;
+#endif
+    };
+
+    // Native code of program compiled by its boots with JIT engine, for memory of the size
+    // they used last, which later boots on memory of that size reuse instead of compiling
+    // program again. Copies of program share it.
+    class JitCache {
+    public:
+        using program_ptr = std::shared_ptr<const JitProgram>;
+
+        // Program compiled for memory of given size, or null.
+        [[nodiscard]] program_ptr get(Memory::mem_size_t size) const {
+            std::lock_guard<std::mutex> guard(lock);
+            if (program != nullptr && program->memory_size() == size) {
+                return program;
+            }
+            return nullptr;
+        }
+
+        void set(program_ptr _program) {
+            std::lock_guard<std::mutex> guard(lock);
+            program = std::move(_program);
+        }
+
+    private:
+        mutable std::mutex lock;
+        program_ptr program;
+    };
+}
+
+using computer::JitProgram;
+
+#endif //JNP1_6_JIT_H
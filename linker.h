@@ -0,0 +1,61 @@
+#ifndef JNP1_6_LINKER_H
+#define JNP1_6_LINKER_H
+
+#include <string>
+#include "computer_components.h"
+
+namespace ooasm {
+    using computer::Memory;
+
+    // Class resolving identifiers of variables to addresses they are declared at. Variables take
+    // consecutive memory cells in order of declaration and the first declaration of given
+    // identifier is the one visible, exactly as in Memory::add_variable.
+    class Linker {
+    public:
+        using address_t = Memory::address_t;
+
+        void declare(const Memory::id_t &name) {
+            symbols.try_emplace(name, declared++);
+        }
+
+        void declare(const computer::PackedId &name) {
+            symbols.try_emplace(name, declared++);
+        }
+
+        [[nodiscard]] address_t resolve(const Memory::id_t &name) const {
+            const computer::IdTable::value_t *address = symbols.find(name);
+            if (address == nullptr) {
+                throw UnresolvedIdentifierException(name);
+            }
+            return *address;
+        }
+
+        [[nodiscard]] address_t resolve(const computer::PackedId &name) const {
+            const computer::IdTable::value_t *address = symbols.find(name);
+            if (address == nullptr) {
+                throw UnresolvedIdentifierException(name.str());
+            }
+            return *address;
+        }
+
+    private:
+        class UnresolvedIdentifierException : public std::exception {
+        public:
+            explicit UnresolvedIdentifierException(const Memory::id_t &name)
+                    : message("Unknown identifier " + name + "! Variables have to be declared "
+                              "with data") {}
+
+            [[nodiscard]] const char *what() const noexcept override {
+                return message.c_str();
+            }
+
+        private:
+            std::string message;
+        };
+
+        address_t declared = 0;
+        computer::IdTable symbols;
+    };
+}
+
+#endif //JNP1_6_LINKER_H
@@ -0,0 +1,442 @@
+#ifndef JNP1_6_LOCKSTEP_H
+#define JNP1_6_LOCKSTEP_H
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+#include "bytecode.h"
+#include "linker.h"
+#include "word.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace computer {
+    using ooasm::Bytecode;
+
+    // Many computers running the same bytecode in lockstep, one per lane. As ooasm has no
+    // control flow, all lanes follow the same instruction stream. Memories are kept as structure
+    // of arrays, word at given address of all lanes lying next to each other, so instructions
+    // become vector kernels over lanes, flags become lane masks and mem(mem(...)) becomes
+    // a gather. Lane which raises an exception stops there, the others go on. Words of every
+    // width wrap around as those of BasicComputer do, and narrower ones fit more lanes in
+    // vector register, though gathers are vectorized only for 64-bit words.
+    template <typename Word>
+    class BasicLockstepComputer {
+    public:
+        using word_t = Word;
+        using address_t = Memory::address_t;
+        using mem_size_t = Memory::mem_size_t;
+        using flag_t = uint8_t;
+        using errors_t = std::vector<std::exception_ptr>;
+
+        BasicLockstepComputer(size_t lanes, mem_size_t mem_size)
+                : _lanes(lanes), _size(mem_size), words(lanes * mem_size, 0), ZF(lanes, 0),
+                  SF(lanes, 0), active(lanes, 1), ones(lanes, 1), buffers(3 * lanes),
+                  addresses(lanes) {}
+
+        [[nodiscard]] size_t lanes() const {
+            return _lanes;
+        }
+
+        [[nodiscard]] mem_size_t memory_size() const {
+            return _size;
+        }
+
+        [[nodiscard]] word_t at(size_t lane, address_t i) const {
+            check_address(i);
+            return row(i)[lane];
+        }
+
+        void set(size_t lane, address_t i, word_t new_val) {
+            check_address(i);
+            row(i)[lane] = new_val;
+        }
+
+        [[nodiscard]] bool getZF(size_t lane) const {
+            return ZF[lane];
+        }
+
+        [[nodiscard]] bool getSF(size_t lane) const {
+            return SF[lane];
+        }
+
+        // Boots bytecode on every lane, as Computer::boot would. Exceptions are reported per
+        // lane, null meaning success.
+        errors_t boot(const Bytecode &code) {
+            std::fill(words.begin(), words.end(), 0);
+            errors_t errors(lanes());
+            linker = ooasm::Linker();
+            address_t slot = 0;
+            for (const Bytecode::Decl &decl : code.declarations()) {
+                if (slot == memory_size()) {
+                    std::fill(errors.begin(), errors.end(),
+                              std::make_exception_ptr(Memory::TooManyVariablesException()));
+                    return errors;
+                }
+                std::fill_n(row(slot++), lanes(), arithmetic_t::wrap(decl.value));
+                linker.declare(code.name(decl.name));
+            }
+            // Verification assumes 64-bit words.
+            run(code, errors, std::is_same_v<Word, int64_t> && code.verified_for(memory_size()));
+            return errors;
+        }
+
+        // Runs bytecode on current state of lanes, e.g. set up with set(), without wiping.
+        errors_t run(const Bytecode &code) {
+            errors_t errors(lanes());
+            linker = ooasm::Linker();
+            for (const Bytecode::Decl &decl : code.declarations()) {
+                linker.declare(code.name(decl.name));
+            }
+            run(code, errors, false);
+            return errors;
+        }
+
+        void memory_dump(size_t lane, std::ostream &os) const {
+            for (mem_size_t i = 0; i < memory_size(); ++i) {
+                os << static_cast<long long>(row(i)[lane]) << " ";
+            }
+        }
+
+    private:
+        using arithmetic_t = WordArithmetic<Word>;
+
+        // Flags marked as dead are skipped only when booting verified bytecode, as marks assume
+        // state right after declarations.
+        void run(const Bytecode &code, errors_t &errors, bool skip_dead_flags) {
+            lane_errors = &errors;
+            current = &code;
+            std::fill(active.begin(), active.end(), 1);
+            active_count = lanes();
+            for (const Bytecode::Op &op : code.code()) {
+                if (active_count == 0) {
+                    break;
+                }
+                switch (op.code) {
+                    case Bytecode::Opcode::Mov:
+                        store(op.dst, load(op.src, source()), nullptr);
+                        break;
+                    case Bytecode::Opcode::Add:
+                    case Bytecode::Opcode::Sub:
+                        arithmetic(op, op.code == Bytecode::Opcode::Sub,
+                                   !(skip_dead_flags && op.flags_dead));
+                        break;
+                    case Bytecode::Opcode::One:
+                        store(op.dst, ones.data(), nullptr);
+                        break;
+                    case Bytecode::Opcode::OneZ:
+                        store(op.dst, ones.data(), ZF.data());
+                        break;
+                    case Bytecode::Opcode::OneS:
+                        store(op.dst, ones.data(), SF.data());
+                        break;
+                }
+            }
+            lane_errors = nullptr;
+            current = nullptr;
+        }
+
+        [[nodiscard]] word_t *row(address_t i) {
+            return words.data() + i * lanes();
+        }
+
+        [[nodiscard]] const word_t *row(address_t i) const {
+            return words.data() + i * lanes();
+        }
+
+        [[nodiscard]] word_t *source() {
+            return buffers.data();
+        }
+
+        [[nodiscard]] word_t *destination() {
+            return buffers.data() + lanes();
+        }
+
+        [[nodiscard]] word_t *result() {
+            return buffers.data() + 2 * lanes();
+        }
+
+        [[nodiscard]] bool all_active() const {
+            return active_count == lanes();
+        }
+
+        void check_address(address_t i) const {
+            if (i >= memory_size()) {
+                throw Memory::OutOfRangeMemoryAccessException();
+            }
+        }
+
+        void fault(size_t lane) {
+            active[lane] = 0;
+            active_count--;
+            (*lane_errors)[lane] =
+                    std::make_exception_ptr(Memory::OutOfRangeMemoryAccessException());
+        }
+
+        [[nodiscard]] bool enabled(size_t lane, const flag_t *condition) const {
+            return active[lane] && (condition == nullptr || condition[lane]);
+        }
+
+        [[nodiscard]] address_t base(const Bytecode::Operand &operand) const {
+            if (operand.mode == Bytecode::Mode::Var) {
+                return linker.resolve(name_of(operand));
+            }
+            return operand.value;
+        }
+
+        [[nodiscard]] const Memory::id_t &name_of(const Bytecode::Operand &operand) const {
+            return current->name(operand.value);
+        }
+
+        // Address to which operand of non-zero depth refers. Operand of depth 1 refers to the
+        // same address in every lane, which is returned in <uniform>; otherwise per lane
+        // addresses are gathered to <addresses>. Enabled lanes whose accesses fall out of
+        // memory fault. Returns whether address is uniform.
+        bool address(const Bytecode::Operand &operand, const flag_t *condition,
+                     address_t &uniform) {
+            uniform = base(operand);
+            if (operand.depth == 1) {
+                if (uniform >= memory_size()) {
+                    for (size_t lane = 0; lane < lanes(); ++lane) {
+                        if (enabled(lane, condition)) {
+                            fault(lane);
+                        }
+                    }
+                }
+                return true;
+            }
+            if (uniform >= memory_size()) {
+                std::fill(addresses.begin(), addresses.end(), uniform);
+            } else {
+                std::transform(row(uniform), row(uniform) + lanes(), addresses.begin(),
+                               arithmetic_t::address);
+            }
+            for (Bytecode::depth_t i = 2; i < operand.depth; ++i) {
+                gather(condition);
+            }
+            for (size_t lane = 0; lane < lanes(); ++lane) {
+                if (enabled(lane, condition) && addresses[lane] >= memory_size()) {
+                    fault(lane);
+                }
+            }
+            return false;
+        }
+
+        // Replaces every enabled lane's address with word it points to in that lane.
+        void gather(const flag_t *condition) {
+            size_t lane = 0;
+#ifdef __AVX2__
+            if constexpr (std::is_same_v<Word, int64_t>) {
+                lane = gather_vector(condition);
+            }
+#endif
+            for (; lane < lanes(); ++lane) {
+                if (!enabled(lane, condition)) {
+                    continue;
+                }
+                if (addresses[lane] >= memory_size()) {
+                    fault(lane);
+                } else {
+                    addresses[lane] = arithmetic_t::address(row(addresses[lane])[lane]);
+                }
+            }
+        }
+
+#ifdef __AVX2__
+        // Gathers addresses of leading lanes four at a time, as long as all of them are
+        // enabled and in bounds. Returns number of lanes gathered.
+        size_t gather_vector(const flag_t *condition) {
+            size_t lane = 0;
+            const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+            const __m256i limit = _mm256_xor_si256(
+                    _mm256_set1_epi64x(static_cast<long long>(memory_size())), sign);
+            const __m256i stride = _mm256_set1_epi64x(static_cast<long long>(lanes()));
+            const auto *base_ptr = reinterpret_cast<const long long *>(words.data());
+            // Indices are computed with 32-bit multiplication.
+            bool small = memory_size() <= UINT32_MAX && lanes() <= UINT32_MAX;
+            for (; small && lane + 4 <= lanes(); lane += 4) {
+                bool all_enabled = true;
+                for (size_t i = lane; i < lane + 4; ++i) {
+                    all_enabled = all_enabled && enabled(i, condition);
+                }
+                if (!all_enabled) {
+                    break;
+                }
+                auto *addr = reinterpret_cast<__m256i *>(addresses.data() + lane);
+                __m256i current_addr = _mm256_loadu_si256(addr);
+                __m256i in_bounds = _mm256_cmpgt_epi64(limit, _mm256_xor_si256(current_addr, sign));
+                if (_mm256_movemask_pd(_mm256_castsi256_pd(in_bounds)) != 0xF) {
+                    break;
+                }
+                __m256i index = _mm256_add_epi64(
+                        _mm256_mul_epu32(current_addr, stride),
+                        _mm256_set_epi64x(lane + 3, lane + 2, lane + 1, lane));
+                _mm256_storeu_si256(addr, _mm256_i64gather_epi64(base_ptr, index, 8));
+            }
+            return lane;
+        }
+#endif
+
+        // Values of operand in every lane. Values of lanes which fault are unspecified.
+        const word_t *load(const Bytecode::Operand &operand, word_t *buffer) {
+            if (operand.depth == 0) {
+                std::fill_n(buffer, lanes(), arithmetic_t::wrap(base(operand)));
+                return buffer;
+            }
+            address_t uniform;
+            if (address(operand, nullptr, uniform)) {
+                return uniform < memory_size() ? row(uniform) : buffer;
+            }
+            for (size_t lane = 0; lane < lanes(); ++lane) {
+                if (active[lane]) {
+                    buffer[lane] = row(addresses[lane])[lane];
+                }
+            }
+            return buffer;
+        }
+
+        // Writes values to operand in every active lane whose <condition>, if given, is set.
+        void store(const Bytecode::Operand &operand, const word_t *values,
+                   const flag_t *condition) {
+            address_t uniform;
+            if (!address(operand, condition, uniform)) {
+                for (size_t lane = 0; lane < lanes(); ++lane) {
+                    if (enabled(lane, condition)) {
+                        row(addresses[lane])[lane] = values[lane];
+                    }
+                }
+                return;
+            }
+            if (uniform >= memory_size()) {
+                return;
+            }
+            word_t *target = row(uniform);
+            if (target == values) {
+                // Values were loaded from the same row, e.g. by mov of cell to itself.
+                return;
+            }
+            if (condition == nullptr && all_active()) {
+                std::copy_n(values, lanes(), target);
+                return;
+            }
+            for (size_t lane = 0; lane < lanes(); ++lane) {
+                target[lane] = enabled(lane, condition) ? values[lane] : target[lane];
+            }
+        }
+
+        void arithmetic(const Bytecode::Op &op, bool subtract, bool flags) {
+            const word_t *a1 = load(op.dst, destination());
+            const word_t *a2 = load(op.src, source());
+            word_t *res = result();
+            if (all_active() && op.dst.depth == 1 && a1 != destination()) {
+                // Every lane updates the same row, so result goes straight into it.
+                res = const_cast<word_t *>(a1);
+            }
+            combine(a1, a2, res, subtract, flags);
+            if (res != a1) {
+                store(op.dst, res, nullptr);
+            }
+        }
+
+        // Computes res = a1 +/- a2 with wraparound and sets flags of active lanes, if <flags>.
+        void combine(const word_t *a1, const word_t *a2, word_t *res, bool subtract,
+                     bool flags) {
+            size_t lane = 0;
+            bool masked = !all_active();
+#ifdef __AVX2__
+            // Byte masks of results give flags of lane i at bit i * sizeof(Word) for zero,
+            // where all bytes of lane are equal, and at its top byte for sign.
+            constexpr size_t step = sizeof(__m256i) / sizeof(Word);
+            const __m256i zero = _mm256_setzero_si256();
+            for (; !masked && lane + step <= lanes(); lane += step) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a1 + lane));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a2 + lane));
+                __m256i r = subtract ? sub_vector(x, y) : add_vector(x, y);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(res + lane), r);
+                if (!flags) {
+                    continue;
+                }
+                auto zero_mask = static_cast<uint32_t>(
+                        _mm256_movemask_epi8(equal_vector(r, zero)));
+                auto sign_mask = static_cast<uint32_t>(_mm256_movemask_epi8(r));
+                for (size_t i = 0; i < step; ++i) {
+                    ZF[lane + i] = (zero_mask >> (i * sizeof(Word))) & 1;
+                    SF[lane + i] = (sign_mask >> (i * sizeof(Word) + sizeof(Word) - 1)) & 1;
+                }
+            }
+#endif
+            for (; lane < lanes(); ++lane) {
+                if (masked && !active[lane]) {
+                    continue;
+                }
+                word_t r = subtract ? arithmetic_t::sub(a1[lane], a2[lane])
+                                    : arithmetic_t::add(a1[lane], a2[lane]);
+                res[lane] = r;
+                if (flags) {
+                    ZF[lane] = arithmetic_t::zero(r);
+                    SF[lane] = arithmetic_t::sign(r);
+                }
+            }
+        }
+
+#ifdef __AVX2__
+        static __m256i add_vector(__m256i x, __m256i y) {
+            if constexpr (sizeof(Word) == 8) {
+                return _mm256_add_epi64(x, y);
+            } else if constexpr (sizeof(Word) == 4) {
+                return _mm256_add_epi32(x, y);
+            } else if constexpr (sizeof(Word) == 2) {
+                return _mm256_add_epi16(x, y);
+            } else {
+                return _mm256_add_epi8(x, y);
+            }
+        }
+
+        static __m256i sub_vector(__m256i x, __m256i y) {
+            if constexpr (sizeof(Word) == 8) {
+                return _mm256_sub_epi64(x, y);
+            } else if constexpr (sizeof(Word) == 4) {
+                return _mm256_sub_epi32(x, y);
+            } else if constexpr (sizeof(Word) == 2) {
+                return _mm256_sub_epi16(x, y);
+            } else {
+                return _mm256_sub_epi8(x, y);
+            }
+        }
+
+        static __m256i equal_vector(__m256i x, __m256i y) {
+            if constexpr (sizeof(Word) == 8) {
+                return _mm256_cmpeq_epi64(x, y);
+            } else if constexpr (sizeof(Word) == 4) {
+                return _mm256_cmpeq_epi32(x, y);
+            } else if constexpr (sizeof(Word) == 2) {
+                return _mm256_cmpeq_epi16(x, y);
+            } else {
+                return _mm256_cmpeq_epi8(x, y);
+            }
+        }
+#endif
+
+        size_t _lanes;
+        mem_size_t _size;
+        std::vector<word_t> words;
+        std::vector<flag_t> ZF, SF, active;
+        size_t active_count = 0;
+        std::vector<word_t> ones, buffers;
+        std::vector<address_t> addresses;
+        ooasm::Linker linker;
+        const Bytecode *current = nullptr;
+        errors_t *lane_errors = nullptr;
+    };
+
+    using LockstepComputer = BasicLockstepComputer<int64_t>;
+}
+
+using computer::LockstepComputer;
+
+#endif //JNP1_6_LOCKSTEP_H
@@ -4,87 +4,130 @@
 namespace ooasm {
     class Data : public Instruction {
     public:
-        Data(ID::id_t _id, std::unique_ptr<Num> _value)
+        Data(ID::id_t _id, node_ptr<Num> _value)
             : id(_id), value(std::move(_value)) {}
 
         void execute(ProcessorAbstract &, Memory &) const override {}
 
         void declare(Memory &memory) const override {
-            memory.add_variable(id.get(), value->get(memory));
+            memory.add_variable(id.key(), value->get(memory));
+        }
+
+        void declare(Linker &linker) const override {
+            linker.declare(id.key());
+        }
+
+        void compile(Bytecode &code) const override {
+            code.declare(id.get(), value->encode(code).value);
         }
 
     private:
         ID id;
-        const std::unique_ptr<Num> value;
+        const node_ptr<Num> value;
     };
 
     class Mov : public Instruction {
     public:
-        Mov(std::unique_ptr<LValue> _dst, std::unique_ptr<RValue> _src)
+        Mov(node_ptr<LValue> _dst, node_ptr<RValue> _src)
                 : dst(std::move(_dst)), src(std::move(_src)) {}
 
         void execute(ProcessorAbstract &, Memory &memory) const override {
             dst->set(memory, src->get(memory));
         }
 
+        void compile(Bytecode &code) const override {
+            code.emit(Bytecode::Opcode::Mov, dst->encode(code), src->encode(code));
+        }
+
+        [[nodiscard]] std::optional<Bytecode::Opcode> kind() const override {
+            return Bytecode::Opcode::Mov;
+        }
+
+        void link(const Linker &linker) override {
+            dst->link(linker);
+            src->link(linker);
+        }
+
     private:
-        const std::unique_ptr<LValue> dst;
-        const std::unique_ptr<RValue> src;
+        const node_ptr<LValue> dst;
+        const node_ptr<RValue> src;
     };
 
     // Abstract class for handling any arithmetic operation performed in ooasm.
     // Deriving classes should overwrite the method <function> to choose performed operation.
     class ArithmeticOperation : public Instruction {
     public:
+        // Results wrap around, as bytecode computes them.
+        using arithmetic_t = Memory::arithmetic_t;
+
         void execute(ProcessorAbstract &processorAbstract, Memory &memory) const override {
             word_t res = function(arg1->get(memory), arg2->get(memory));
-            set_flags(res, processorAbstract);
+            processorAbstract.set_result(res);
             set_value(res, memory);
         }
 
+        void compile(Bytecode &code) const override {
+            code.emit(opcode(), arg1->encode(code), arg2->encode(code));
+        }
+
+        [[nodiscard]] std::optional<Bytecode::Opcode> kind() const override {
+            return opcode();
+        }
+
+        void link(const Linker &linker) override {
+            arg1->link(linker);
+            arg2->link(linker);
+        }
+
         virtual ~ArithmeticOperation() = default;
 
     protected:
-        ArithmeticOperation(std::unique_ptr<LValue> _arg1, std::unique_ptr<RValue> _arg2)
+        ArithmeticOperation(node_ptr<LValue> _arg1, node_ptr<RValue> _arg2)
                 : arg1(std::move(_arg1)), arg2(std::move(_arg2)) {}
 
     private:
-        const std::unique_ptr<LValue> arg1;
-        const std::unique_ptr<RValue> arg2;
+        const node_ptr<LValue> arg1;
+        const node_ptr<RValue> arg2;
 
         void set_value(word_t res, Memory &memory) const {
             arg1->set(memory, res);
         }
 
-        static void set_flags(word_t res, ProcessorAbstract &processorAbstract) {
-            processorAbstract.setSF(res < 0);
-            processorAbstract.setZF(res == 0);
-        }
-
         // Function to be applied on given values.
         [[nodiscard]] virtual word_t function(word_t a1, word_t a2) const = 0;
+
+        // Bytecode counterpart of <function>.
+        [[nodiscard]] virtual Bytecode::Opcode opcode() const = 0;
     };
 
     class Add : public ArithmeticOperation {
     public:
-        Add(std::unique_ptr<LValue> _arg1, std::unique_ptr<RValue> _arg2)
+        Add(node_ptr<LValue> _arg1, node_ptr<RValue> _arg2)
                 : ArithmeticOperation(std::move(_arg1), std::move(_arg2)) {}
 
     private:
         [[nodiscard]] word_t function(word_t a1, word_t a2) const override {
-            return a1 + a2;
+            return arithmetic_t::add(a1, a2);
+        }
+
+        [[nodiscard]] Bytecode::Opcode opcode() const override {
+            return Bytecode::Opcode::Add;
         }
 
     };
 
     class Sub : public ArithmeticOperation {
     public:
-        Sub(std::unique_ptr<LValue> _arg1, std::unique_ptr<RValue> _arg2)
+        Sub(node_ptr<LValue> _arg1, node_ptr<RValue> _arg2)
                 : ArithmeticOperation(std::move(_arg1), std::move(_arg2)) {}
 
     private:
         [[nodiscard]] word_t function(word_t a1, word_t a2) const override {
-            return a1 - a2;
+            return arithmetic_t::sub(a1, a2);
+        }
+
+        [[nodiscard]] Bytecode::Opcode opcode() const override {
+            return Bytecode::Opcode::Sub;
         }
     };
 
@@ -92,7 +135,7 @@ namespace ooasm {
     // Deriving classes should override should_set function to choose when 1 should be set.
     class One : public Instruction {
     public:
-        explicit One(std::unique_ptr<LValue> _lValue) : lValue(std::move(_lValue)) {}
+        explicit One(node_ptr<LValue> _lValue) : lValue(std::move(_lValue)) {}
 
         void execute(ProcessorAbstract &processorAbstract, Memory &memory) const override {
             if (should_set(processorAbstract)) {
@@ -100,6 +143,18 @@ namespace ooasm {
             }
         }
 
+        void compile(Bytecode &code) const override {
+            code.emit(opcode(), lValue->encode(code));
+        }
+
+        [[nodiscard]] std::optional<Bytecode::Opcode> kind() const override {
+            return opcode();
+        }
+
+        void link(const Linker &linker) override {
+            lValue->link(linker);
+        }
+
         ~One() override = default;
 
     protected:
@@ -107,29 +162,111 @@ namespace ooasm {
             return true;
         }
 
+        // Bytecode counterpart of <should_set>.
+        [[nodiscard]] virtual Bytecode::Opcode opcode() const {
+            return Bytecode::Opcode::One;
+        }
+
     private:
-        std::unique_ptr<LValue> lValue;
+        node_ptr<LValue> lValue;
     };
 
     class OneZ : public One {
     public:
-        explicit OneZ(std::unique_ptr<LValue> _lValue) : One(std::move(_lValue)) {}
+        explicit OneZ(node_ptr<LValue> _lValue) : One(std::move(_lValue)) {}
 
     protected:
         [[nodiscard]] bool should_set(const ProcessorAbstract &processorAbstract) const override {
             return processorAbstract.getZF();
         }
+
+        [[nodiscard]] Bytecode::Opcode opcode() const override {
+            return Bytecode::Opcode::OneZ;
+        }
     };
 
     class OneS : public One {
     public:
-        explicit OneS(std::unique_ptr<LValue> _lValue) : One(std::move(_lValue)) {}
+        explicit OneS(node_ptr<LValue> _lValue) : One(std::move(_lValue)) {}
 
     protected:
         [[nodiscard]] bool should_set(const ProcessorAbstract &processorAbstract) const override {
             return processorAbstract.getSF();
         }
+
+        [[nodiscard]] Bytecode::Opcode opcode() const override {
+            return Bytecode::Opcode::OneS;
+        }
     };
+
+    node_ptr<Num> ProgramBuilder::num(word_t word) {
+        return arena->make<Num>(word);
+    }
+
+    node_ptr<Mem> ProgramBuilder::mem(node_ptr<RValue> addr) {
+        return arena->make<Mem>(std::move(addr));
+    }
+
+    node_ptr<LEA> ProgramBuilder::lea(ID::id_t id) {
+        return arena->make<LEA>(id);
+    }
+
+    template <typename T, typename... Args>
+    ProgramBuilder &ProgramBuilder::emplace(Args &&... args) {
+        T *instruction = arena->make_instruction<T>(std::forward<Args>(args)...);
+        return append(std::shared_ptr<Instruction>(arena, instruction));
+    }
+
+    ProgramBuilder &ProgramBuilder::data(ID::id_t id, node_ptr<Num> value) {
+        return emplace<Data>(id, std::move(value));
+    }
+
+    ProgramBuilder &ProgramBuilder::mov(node_ptr<LValue> dst, node_ptr<RValue> src) {
+        return emplace<Mov>(std::move(dst), std::move(src));
+    }
+
+    ProgramBuilder &ProgramBuilder::add(node_ptr<LValue> arg1, node_ptr<RValue> arg2) {
+        return emplace<Add>(std::move(arg1), std::move(arg2));
+    }
+
+    ProgramBuilder &ProgramBuilder::sub(node_ptr<LValue> arg1, node_ptr<RValue> arg2) {
+        return emplace<Sub>(std::move(arg1), std::move(arg2));
+    }
+
+    ProgramBuilder &ProgramBuilder::inc(node_ptr<LValue> arg) {
+        return emplace<Add>(std::move(arg), num(1));
+    }
+
+    ProgramBuilder &ProgramBuilder::dec(node_ptr<LValue> arg) {
+        return emplace<Sub>(std::move(arg), num(1));
+    }
+
+    ProgramBuilder &ProgramBuilder::one(node_ptr<LValue> arg) {
+        return emplace<One>(std::move(arg));
+    }
+
+    ProgramBuilder &ProgramBuilder::onez(node_ptr<LValue> arg) {
+        return emplace<OneZ>(std::move(arg));
+    }
+
+    ProgramBuilder &ProgramBuilder::ones(node_ptr<LValue> arg) {
+        return emplace<OneS>(std::move(arg));
+    }
+
+    Program ProgramBuilder::build() {
+        Program program(std::move(ins), std::move(arena));
+        ins = std::vector<std::shared_ptr<Instruction>>();
+        arena = std::make_shared<Arena>();
+        return program;
+    }
+
+    Bytecode::Bytecode(const Program &program) {
+        for (const std::shared_ptr<Instruction> &ins : program) {
+            ins->compile(*this);
+        }
+        link();
+        boot_images = program.boot_images;
+    }
 }
 
 using namespace ooasm;
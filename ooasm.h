@@ -3,7 +3,10 @@
 
 #include <vector>
 #include <cstring>
+#include <string_view>
 #include "instruction.h"
+#include "arena.h"
+#include "jit.h"
 #include <iterator>
 
 // Implementation detail namespace concerning ooasm language.
@@ -18,7 +21,16 @@ namespace ooasm {
         using iterator = ins_t::const_iterator;
 
         Program(std::initializer_list<std::shared_ptr<Instruction>> &&instructions)
-                : ins(instructions) {}
+                : ins(instructions) {
+            link();
+        }
+
+        // Program taking over instructions, which may live in given arena.
+        explicit Program(std::vector<std::shared_ptr<Instruction>> &&instructions,
+                         std::shared_ptr<Arena> _arena = nullptr)
+                : arena(std::move(_arena)), ins(std::move(instructions)) {
+            link();
+        }
 
         [[nodiscard]] iterator begin() const {
             return ins.begin();
@@ -28,8 +40,37 @@ namespace ooasm {
             return ins.end();
         }
 
+        // Image of memory after declarations of program, cached by its boots.
+        [[nodiscard]] computer::BootImageCache &boot_image() const {
+            return *boot_images;
+        }
+
+        // Native code compiled from program by its boots with JIT engine.
+        [[nodiscard]] computer::JitCache &jit() const {
+            return *jit_programs;
+        }
+
     private:
+        // Bytecode compiled from program shares its boot image, as declarations are the same.
+        friend class Bytecode;
+
+        std::shared_ptr<Arena> arena;
         ins_t ins;
+        std::shared_ptr<computer::BootImageCache> boot_images =
+                std::make_shared<computer::BootImageCache>();
+        std::shared_ptr<computer::JitCache> jit_programs = std::make_shared<computer::JitCache>();
+
+        // Declarations are known up front, so identifiers are bound once here instead of being
+        // looked up in memory on every execution.
+        void link() const {
+            Linker linker;
+            for (const std::shared_ptr<Instruction> &i : ins) {
+                i->declare(linker);
+            }
+            for (const std::shared_ptr<Instruction> &i : ins) {
+                i->link(linker);
+            }
+        }
     };
 
     // Class for identifiers.
@@ -46,10 +87,16 @@ namespace ooasm {
                 throw InvalidId();
             }
 
-            id = Memory::id_t(_id);
+            id = computer::PackedId(std::string_view(_id, len));
         }
 
         [[nodiscard]] Memory::id_t get() const {
+            return id.str();
+        }
+
+        // Identifier packed into fixed-width key, which memories and linkers look up without
+        // hashing strings.
+        [[nodiscard]] const computer::PackedId &key() const {
             return id;
         }
 
@@ -57,8 +104,9 @@ namespace ooasm {
         // ID size constraints.
         constexpr static size_t MAX_LEN = 10;
         constexpr static size_t MIN_LEN = 1;
+        static_assert(MAX_LEN <= computer::PackedId::MAX_LENGTH);
 
-        Memory::id_t id;
+        computer::PackedId id;
 
         class InvalidId : public std::exception {
             [[nodiscard]] const char *what() const noexcept override {
@@ -77,6 +125,12 @@ namespace ooasm {
             return get(memory);
         }
 
+        // Pure virtual method to get operand encoding of RValue.
+        [[nodiscard]] virtual Bytecode::Operand encode(Bytecode &) const = 0;
+
+        // Virtual method to bind identifiers used by RValue to addresses of variables.
+        virtual void link(const Linker &) {}
+
         virtual ~RValue() = default;
     };
 
@@ -91,7 +145,7 @@ namespace ooasm {
     // Underlying class for mem language element.
     class Mem : public LValue {
     public:
-        explicit Mem(std::unique_ptr<RValue> _addr) : addr(std::move(_addr)) {}
+        explicit Mem(node_ptr<RValue> _addr) : addr(std::move(_addr)) {}
 
         [[nodiscard]] word_t get(const Memory &memory) const override {
             return memory.at(get_addr(memory));
@@ -101,12 +155,22 @@ namespace ooasm {
             memory.set(get_addr(memory), word);
         }
 
+        [[nodiscard]] Bytecode::Operand encode(Bytecode &code) const override {
+            Bytecode::Operand operand = addr->encode(code);
+            operand.depth++;
+            return operand;
+        }
+
+        void link(const Linker &linker) override {
+            addr->link(linker);
+        }
+
     private:
         [[nodiscard]] word_t get_addr(const Memory &memory) const {
             return addr->get_address(memory);
         }
 
-        std::unique_ptr<RValue> addr;
+        node_ptr<RValue> addr;
     };
 
     // Underlying class for num language element.
@@ -118,6 +182,10 @@ namespace ooasm {
             return num;
         }
 
+        [[nodiscard]] Bytecode::Operand encode(Bytecode &) const override {
+            return {num, 0, Bytecode::Mode::Imm, false};
+        }
+
     private:
         word_t num;
     };
@@ -129,15 +197,107 @@ namespace ooasm {
         explicit LEA(ID::id_t _id) : id(_id) {}
 
         [[nodiscard]] address_t get_address(const Memory &memory) const override {
-            return memory.get_variable_address(id.get());
+            if (binding == Binding::Static) {
+                return slot;
+            }
+            return memory.get_variable_address(id.key());
         }
 
         [[nodiscard]] word_t get(const Memory &memory) const override {
             return get_address(memory);
         }
 
+        [[nodiscard]] Bytecode::Operand encode(Bytecode &code) const override {
+            return {code.intern(id.get()), 0, Bytecode::Mode::Var, false};
+        }
+
+        void link(const Linker &linker) override {
+            address_t resolved = linker.resolve(id.key());
+            if (binding == Binding::None) {
+                slot = resolved;
+                binding = Binding::Static;
+            } else if (slot != resolved) {
+                binding = Binding::Dynamic;
+            }
+        }
+
     private:
+        // Node shared by programs which declare its variable at different addresses has to
+        // fall back to looking the address up in memory.
+        enum class Binding {
+            None, Static, Dynamic
+        };
+
         ID id;
+        Binding binding = Binding::None;
+        address_t slot = 0;
+    };
+
+    // Builds program incrementally, allocating its instructions and operands in an arena
+    // owned by the program instead of separately on heap. Methods mirror language elements;
+    // those of instructions append them to program. Operands created by builder belong to it
+    // and can be used only in instructions of the same builder.
+    class ProgramBuilder {
+    public:
+        ProgramBuilder() : arena(std::make_shared<Arena>()) {}
+
+        void reserve(size_t instructions) {
+            ins.reserve(instructions);
+            arena->reserve(instructions);
+        }
+
+        ProgramBuilder &append(std::shared_ptr<Instruction> instruction) {
+            ins.push_back(std::move(instruction));
+            return *this;
+        }
+
+        // Appends instructions of other builder, which keep its arena alive.
+        ProgramBuilder &append(ProgramBuilder &&other) {
+            ins.insert(ins.end(), std::make_move_iterator(other.ins.begin()),
+                       std::make_move_iterator(other.ins.end()));
+            other.ins.clear();
+            return *this;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return ins.size();
+        }
+
+        node_ptr<Num> num(word_t word);
+
+        node_ptr<Mem> mem(node_ptr<RValue> addr);
+
+        node_ptr<LEA> lea(ID::id_t id);
+
+        ProgramBuilder &data(ID::id_t id, node_ptr<Num> value);
+
+        ProgramBuilder &mov(node_ptr<LValue> dst, node_ptr<RValue> src);
+
+        ProgramBuilder &add(node_ptr<LValue> arg1, node_ptr<RValue> arg2);
+
+        ProgramBuilder &sub(node_ptr<LValue> arg1, node_ptr<RValue> arg2);
+
+        ProgramBuilder &inc(node_ptr<LValue> arg);
+
+        ProgramBuilder &dec(node_ptr<LValue> arg);
+
+        ProgramBuilder &one(node_ptr<LValue> arg);
+
+        ProgramBuilder &onez(node_ptr<LValue> arg);
+
+        ProgramBuilder &ones(node_ptr<LValue> arg);
+
+        // Links and returns built program, leaving builder empty.
+        Program build();
+
+    private:
+        std::shared_ptr<Arena> arena;
+        std::vector<std::shared_ptr<Instruction>> ins;
+
+        // Appends instruction created in arena. It shares ownership of arena instead of having
+        // its own control block.
+        template <typename T, typename... Args>
+        ProgramBuilder &emplace(Args &&... args);
     };
 }
 
@@ -182,4 +342,6 @@ std::shared_ptr<ooasm::Instruction> ones(std::unique_ptr<ooasm::LValue> arg);
 
 using program = ooasm::Program;
 
+using ooasm::ProgramBuilder;
+
 #endif //JNP1_6_OOASM_H
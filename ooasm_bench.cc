@@ -0,0 +1,623 @@
+#include "assembler.h"
+#include "computer.h"
+#include "fleet.h"
+#include "incremental.h"
+#include "lockstep.h"
+#include "optimizer.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Benchmark suite of ooasm toolchain. Usage:
+//     ooasm_bench [--scale N] [--json FILE] [--baseline FILE] [--threshold FRACTION]
+// Results are printed and optionally written as JSON object mapping names of metrics to values.
+// Metrics ending with _ns are better when lower, others when higher. Given baseline, metrics
+// worse than it by more than threshold (0.10 by default) are reported and exit status is 1.
+// ooasm_bench_baseline.json holds results of Release build at scale 1 on a single core, see
+// README.md; metrics missing from baseline, e.g. of assembler on more threads, are not compared.
+// Engine which leaves other state than tree engine is reported and exit status is 3.
+namespace {
+    using computer::Computer;
+    using computer::Memory;
+    using ooasm::Bytecode;
+    using ooasm::ProgramBuilder;
+
+    using results_t = std::map<std::string, double>;
+
+    struct Options {
+        size_t scale = 1;
+        std::string json;
+        std::string baseline;
+        double threshold = 0.10;
+    };
+
+    struct Workload {
+        std::string name;
+        ooasm::Program program;
+        Memory::mem_size_t size;
+    };
+
+    // Identifier of 10 characters, the longest allowed, unique for every index.
+    std::string long_id(size_t i) {
+        std::string id = "v000000000";
+        for (size_t at = id.size() - 1; i > 0; --at, i /= 10) {
+            id[at] = static_cast<char>('0' + i % 10);
+        }
+        return id;
+    }
+
+    // Long runs of mov between static cells and from immediates.
+    Workload mov_runs(size_t count) {
+        constexpr Memory::mem_size_t size = 1024;
+        std::mt19937_64 random(1);
+        ProgramBuilder b;
+        b.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            auto dst = static_cast<Memory::word_t>(random() % size);
+            if (i % 2 == 0) {
+                b.mov(b.mem(b.num(dst)), b.num(static_cast<Memory::word_t>(random() % 1000)));
+            } else {
+                b.mov(b.mem(b.num(dst)), b.mem(b.num(static_cast<Memory::word_t>(i % size))));
+            }
+        }
+        return {"mov_runs", b.build(), size};
+    }
+
+    // Operands dereferencing chains of <depth> cells, each pointing to the next one.
+    Workload deep_chains(size_t count, size_t depth) {
+        const Memory::mem_size_t size = depth + 2;
+        ProgramBuilder b;
+        b.reserve(count + size);
+        for (size_t i = 0; i < depth; ++i) {
+            b.mov(b.mem(b.num(static_cast<Memory::word_t>(i))),
+                  b.num(static_cast<Memory::word_t>(i + 1)));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            ooasm::node_ptr<ooasm::RValue> chain = b.num(0);
+            for (size_t d = 0; d < depth; ++d) {
+                chain = b.mem(std::move(chain));
+            }
+            b.add(b.mem(b.num(static_cast<Memory::word_t>(depth + 1))), std::move(chain));
+        }
+        return {"deep_chains", b.build(), size};
+    }
+
+    // Many declarations with 10-character identifiers, referenced by lea.
+    Workload declarations(size_t count) {
+        ProgramBuilder b;
+        b.reserve(2 * count);
+        std::vector<std::string> ids;
+        ids.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            ids.push_back(long_id(i));
+            b.data(ids.back().c_str(), b.num(static_cast<Memory::word_t>(i)));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            b.inc(b.mem(b.lea(ids[(i * 7919) % count].c_str())));
+        }
+        return {"declarations", b.build(), count};
+    }
+
+    // Arithmetic on cells whose results feed conditional instructions.
+    Workload arithmetic(size_t count) {
+        constexpr Memory::mem_size_t size = 64;
+        std::mt19937_64 random(2);
+        ProgramBuilder b;
+        b.reserve(count);
+        b.data("acc", b.num(0));
+        for (size_t i = 0; i < count; ++i) {
+            auto cell = static_cast<Memory::word_t>(1 + random() % (size - 1));
+            switch (i % 5) {
+                case 0:
+                    b.add(b.mem(b.lea("acc")), b.mem(b.num(cell)));
+                    break;
+                case 1:
+                    b.sub(b.mem(b.num(cell)), b.num(static_cast<Memory::word_t>(random() % 7)));
+                    break;
+                case 2:
+                    b.onez(b.mem(b.num(cell)));
+                    break;
+                case 3:
+                    b.ones(b.mem(b.num(cell)));
+                    break;
+                default:
+                    b.dec(b.mem(b.lea("acc")));
+                    break;
+            }
+        }
+        return {"arithmetic", b.build(), size};
+    }
+
+    // Scattered accesses to memory too large to be allocated densely.
+    Workload large_memory(size_t count) {
+        constexpr Memory::mem_size_t size = Memory::mem_size_t(1) << 32;
+        std::mt19937_64 random(3);
+        ProgramBuilder b;
+        b.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            auto cell = static_cast<Memory::word_t>(random() % size);
+            if (i % 2 == 0) {
+                b.mov(b.mem(b.num(cell)), b.num(static_cast<Memory::word_t>(i)));
+            } else {
+                b.inc(b.mem(b.num(cell)));
+            }
+        }
+        return {"large_memory", b.build(), size};
+    }
+
+    // Median time of <runs> calls of <function>, in nanoseconds.
+    double median_ns(size_t runs, const std::function<void()> &function) {
+        std::vector<double> times;
+        for (size_t run = 0; run < runs; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() -
+                                                            start;
+            times.push_back(time.count());
+        }
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    void record(results_t &results, const std::string &name, double value) {
+        results[name] = value;
+        std::printf("%-48s %16.1f\n", name.c_str(), value);
+    }
+
+    // Words at checked cells and flags which boot left.
+    struct State {
+        std::vector<int64_t> words;
+        bool ZF;
+        bool SF;
+
+        bool operator==(const State &other) const {
+            return words == other.words && ZF == other.ZF && SF == other.SF;
+        }
+    };
+
+    struct Engine {
+        std::string name;
+        std::function<void()> boot;
+        // Whether state of every computer booted equals that tree engine left.
+        std::function<bool()> matches;
+        // Programs run by one boot.
+        size_t programs = 1;
+    };
+
+    // Memories up to this many words are compared whole after boots of every engine.
+    constexpr Memory::mem_size_t CHECKED_WORDS = Memory::mem_size_t(1) << 22;
+    // Lanes of lockstep engine and computers of fleet engine.
+    constexpr size_t LANES = 4;
+
+    // Addresses at which engines have to leave the same words: whole memory or, when it is too
+    // large to compare after every engine, variables and cells which ops address directly,
+    // which are all that workloads scattering accesses over such memory touch.
+    std::vector<Memory::address_t> checked_cells(const Workload &w, const Bytecode &code) {
+        std::vector<Memory::address_t> cells;
+        if (w.size <= CHECKED_WORDS) {
+            cells.resize(w.size);
+            std::iota(cells.begin(), cells.end(), 0);
+            return cells;
+        }
+        for (Memory::address_t i = 0; i < code.declarations().size(); ++i) {
+            cells.push_back(i);
+        }
+        for (const Bytecode::Op &op : code.code()) {
+            for (const Bytecode::Operand *operand : {&op.dst, &op.src}) {
+                auto address = static_cast<Memory::address_t>(operand->value);
+                if (operand->depth == 1 && operand->mode == Bytecode::Mode::Imm &&
+                    address < w.size) {
+                    cells.push_back(address);
+                }
+            }
+        }
+        std::sort(cells.begin(), cells.end());
+        cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+        return cells;
+    }
+
+    // Boot latency and instructions per second of every execution path. Instructions are those
+    // of source program, so rates of engines which skip or evaluate some in advance are effective.
+    // State every engine leaves is compared with that of tree engine, which runs first.
+    void bench_engines(const Workload &w, size_t runs, results_t &results) {
+        Computer computer(w.size);
+        computer::BasicComputer<int32_t> computer32(w.size);
+        computer::BasicComputer<int16_t> computer16(w.size);
+        Bytecode checked(w.program);
+        Bytecode verified(w.program);
+        ooasm::verify(verified, w.size);
+        Bytecode optimized(w.program);
+        ooasm::optimize(optimized, w.size);
+        ooasm::verify(optimized, w.size);
+        computer::JitProgram jit(verified, w.size);
+        ooasm::PartialProgram partial(verified, w.size);
+        ParallelProgram parallel(verified, w.size);
+        computer::ThreadPool pool;
+        ComputerFleet fleet(LANES, w.size);
+
+        std::vector<Memory::address_t> cells = checked_cells(w, checked);
+        auto state_of = [&](const auto &c) {
+            State state{{}, c.getZF(), c.getSF()};
+            state.words.reserve(cells.size());
+            for (Memory::address_t i : cells) {
+                state.words.push_back(c.at(i));
+            }
+            return state;
+        };
+        State expected;
+        auto same = [&](const Computer &c) {
+            return state_of(c) == expected;
+        };
+        // Words of narrower computers wrap where those of tree engine do not, which changes
+        // flags but not words wrapped to their width.
+        auto same_wrapped = [&](const auto &c) {
+            using word_t = typename std::remove_reference_t<decltype(c)>::word_t;
+            State state = state_of(c);
+            for (size_t i = 0; i < cells.size(); ++i) {
+                if (state.words[i] != static_cast<word_t>(expected.words[i])) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        std::vector<Engine> engines = {
+                {"tree", [&] { computer.boot(w.program); }, [&] {
+                    expected = state_of(computer);
+                    return true;
+                }},
+                {"bytecode", [&] { computer.boot(checked); }, [&] { return same(computer); }},
+                {"bytecode_int32", [&] { computer32.boot(checked); },
+                 [&] { return same_wrapped(computer32); }},
+                {"bytecode_int16", [&] { computer16.boot(checked); },
+                 [&] { return same_wrapped(computer16); }},
+                {"bytecode_verified", [&] { computer.boot(verified); },
+                 [&] { return same(computer); }},
+                {"bytecode_async", [&] { computer.boot_async(verified, 4096).run(); },
+                 [&] { return same(computer); }},
+                {"optimized", [&] { computer.boot(optimized); }, [&] { return same(computer); }},
+                {"partial", [&] { computer.boot(partial); }, [&] { return same(computer); }},
+                {"parallel", [&] { computer.boot(parallel, pool); },
+                 [&] { return same(computer); }},
+                {"fleet", [&] { fleet.boot(verified); }, [&] {
+                    for (size_t i = 0; i < fleet.size(); ++i) {
+                        if (!same(fleet[i])) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }, LANES},
+        };
+        if (jit.compiled()) {
+            engines.push_back({"jit", [&] { computer.boot(jit); }, [&] { return same(computer); }});
+        }
+        // Lanes keep whole memories densely.
+        std::unique_ptr<LockstepComputer> lockstep;
+        if (w.size <= CHECKED_WORDS) {
+            lockstep = std::make_unique<LockstepComputer>(LANES, w.size);
+            engines.push_back({"lockstep", [&] { lockstep->boot(verified); }, [&] {
+                for (size_t lane = 0; lane < lockstep->lanes(); ++lane) {
+                    State state{{}, lockstep->getZF(lane), lockstep->getSF(lane)};
+                    for (Memory::address_t i : cells) {
+                        state.words.push_back(lockstep->at(lane, i));
+                    }
+                    if (!(state == expected)) {
+                        return false;
+                    }
+                }
+                return true;
+            }, LANES});
+        }
+        auto ops = static_cast<double>(checked.code().size());
+        for (const Engine &engine : engines) {
+            std::string prefix = w.name + "/" + engine.name + "/";
+            double ns = median_ns(runs, engine.boot);
+            record(results, prefix + "boot_ns", ns);
+            record(results, prefix + "instructions_per_s",
+                   ops * static_cast<double>(engine.programs) / ns * 1e9);
+            if (!engine.matches()) {
+                std::fprintf(stderr, "MISMATCH %s left other state than tree engine\n",
+                             (w.name + "/" + engine.name).c_str());
+                std::exit(3);
+            }
+        }
+    }
+
+    // Time in which boots of <tenants> small programs finish when submitted to scheduler right
+    // after boot of large one, which shares threads with them.
+    void bench_scheduler(const Workload &large, const Workload &small, size_t tenants,
+                         results_t &results) {
+        computer::Scheduler scheduler(1024);
+        Computer computer(large.size);
+        Bytecode large_code(large.program);
+        ooasm::verify(large_code, large.size);
+        Bytecode small_code(small.program);
+        ooasm::verify(small_code, small.size);
+        std::deque<Computer> computers;
+        for (size_t i = 0; i < tenants; ++i) {
+            computers.emplace_back(small.size);
+        }
+        std::vector<computer::Scheduler::Job> jobs;
+        std::vector<double> times;
+        for (size_t run = 0; run < 5; ++run) {
+            computer::Scheduler::Job large_job = scheduler.submit(computer, large_code);
+            auto start = std::chrono::steady_clock::now();
+            jobs.clear();
+            for (Computer &tenant : computers) {
+                jobs.push_back(scheduler.submit(tenant, small_code));
+            }
+            for (const computer::Scheduler::Job &job : jobs) {
+                job.wait();
+            }
+            std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() -
+                                                            start;
+            times.push_back(time.count());
+            large_job.wait();
+        }
+        std::sort(times.begin(), times.end());
+        record(results, "scheduler/small_boots_ns", times[times.size() / 2]);
+        record(results, "scheduler/large_boot_ns",
+               median_ns(5, [&] { scheduler.submit(computer, large_code).wait(); }));
+    }
+
+    // Boot after editing one instruction in the middle of program, which reruns it from the
+    // nearest checkpoint until state converges with that of the previous boot.
+    void bench_incremental(const Workload &w, results_t &results) {
+        computer::IncrementalComputer computer(w.size, w.program);
+        computer.boot();
+        size_t middle = computer.size() / 2;
+        record(results, w.name + "/incremental_edit/boot_ns", median_ns(11, [&] {
+            computer.replace(middle, computer.instruction(middle));
+            computer.boot();
+        }));
+    }
+
+    void bench_memory(Memory::mem_size_t size, computer::Backing backing, const std::string &name,
+                      results_t &results) {
+        Memory memory(size, backing);
+        for (Memory::address_t i = 0; i < size; i += 4096) {
+            memory.set(i, static_cast<Memory::word_t>(i));
+        }
+        record(results, "memory/" + name + "/wipe_ns", median_ns(5, [&] { memory.wipe(); }));
+    }
+
+    // Declaring and looking up <count> variables with 10-character identifiers, per variable.
+    void bench_identifiers(size_t count, results_t &results) {
+        std::vector<computer::PackedId> keys;
+        keys.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            keys.emplace_back(long_id(i));
+        }
+        std::vector<computer::PackedId> shuffled = keys;
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(5));
+        auto n = static_cast<double>(count);
+        Memory memory(count, computer::Backing::Dense);
+        ooasm::Linker linker;
+        Memory::address_t sum = 0;
+
+        record(results, "identifiers/memory_declare_ns", median_ns(5, [&] {
+            memory.wipe();
+            for (const computer::PackedId &key : keys) {
+                memory.add_variable(key, 1);
+            }
+        }) / n);
+        record(results, "identifiers/memory_lookup_ns", median_ns(5, [&] {
+            for (const computer::PackedId &key : shuffled) {
+                sum += memory.get_variable_address(key);
+            }
+        }) / n);
+        record(results, "identifiers/linker_declare_ns", median_ns(5, [&] {
+            linker = ooasm::Linker();
+            for (const computer::PackedId &key : keys) {
+                linker.declare(key);
+            }
+        }) / n);
+        record(results, "identifiers/linker_resolve_ns", median_ns(5, [&] {
+            for (const computer::PackedId &key : shuffled) {
+                sum += linker.resolve(key);
+            }
+        }) / n);
+        if (sum == 0) {
+            std::printf("\n");
+        }
+    }
+
+    void bench_dump(Memory::mem_size_t size, results_t &results) {
+        Computer computer(size, computer::Backing::Dense);
+        ProgramBuilder b;
+        std::mt19937_64 random(4);
+        for (int i = 0; i < 1024; ++i) {
+            b.mov(b.mem(b.num(static_cast<Memory::word_t>(random() % size))),
+                  b.num(static_cast<Memory::word_t>(random())));
+        }
+        computer.boot(b.build());
+        auto words = static_cast<double>(size);
+        double text = median_ns(5, [&] {
+            std::ostringstream os;
+            computer.memory_dump(os);
+        });
+        double binary = median_ns(5, [&] {
+            std::ostringstream os;
+            computer.memory_dump_binary(os);
+        });
+        record(results, "dump/text/words_per_s", words / text * 1e9);
+        record(results, "dump/binary/words_per_s", words / binary * 1e9);
+    }
+
+    // Source of about <bytes> bytes with instructions of every kind, as generated workloads are.
+    std::string generate_source(size_t bytes) {
+        std::mt19937_64 random(2021);
+        std::string source = "data(\"counter\", num(0))\ndata(\"limit\", num(1000))\n";
+        while (source.size() < bytes) {
+            std::string address = std::to_string(random() % 64);
+            std::string value = std::to_string(static_cast<int64_t>(random() % 2001) - 1000);
+            switch (random() % 6) {
+                case 0:
+                    source += "mov(mem(num(" + address + ")), num(" + value + "))\n";
+                    break;
+                case 1:
+                    source += "add(mem(lea(\"counter\")), mem(num(" + address + ")))\n";
+                    break;
+                case 2:
+                    source += "sub(mem(num(" + address + ")), mem(lea(\"limit\")))\n";
+                    break;
+                case 3:
+                    source += "inc(mem(mem(num(" + address + "))))\n";
+                    break;
+                case 4:
+                    source += "onez(mem(num(" + address + ")))\n";
+                    break;
+                default:
+                    source += "ones(mem(lea(\"counter\")))\n";
+                    break;
+            }
+        }
+        return source;
+    }
+
+    void bench_assembler(const std::string &source, size_t threads, results_t &results) {
+        Assembler assembler(threads);
+        double ns = median_ns(3, [&] {
+            ooasm::Program program = assembler.assemble(source);
+            static_cast<void>(program);
+        });
+        record(results, "assembler/threads_" + std::to_string(threads) + "/mb_per_s",
+               static_cast<double>(source.size()) / 1e6 / ns * 1e9);
+    }
+
+    void write_json(const results_t &results, const std::string &path) {
+        std::ofstream file(path);
+        file.precision(12);
+        file << "{\n";
+        size_t i = 0;
+        for (const auto &[name, value] : results) {
+            file << "  \"" << name << "\": " << value << (++i < results.size() ? ",\n" : "\n");
+        }
+        file << "}\n";
+    }
+
+    // Reads JSON object written by write_json.
+    results_t read_json(const std::string &path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::fprintf(stderr, "Cannot read baseline %s\n", path.c_str());
+            std::exit(2);
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        std::string text = contents.str();
+        results_t results;
+        size_t at = 0;
+        while ((at = text.find('"', at)) != std::string::npos) {
+            size_t end = text.find('"', at + 1);
+            size_t colon = text.find(':', end);
+            if (end == std::string::npos || colon == std::string::npos) {
+                break;
+            }
+            results[text.substr(at + 1, end - at - 1)] = std::strtod(text.c_str() + colon + 1,
+                                                                     nullptr);
+            at = colon + 1;
+        }
+        return results;
+    }
+
+    bool lower_is_better(const std::string &name) {
+        return name.size() >= 3 && name.compare(name.size() - 3, 3, "_ns") == 0;
+    }
+
+    // Reports metrics worse than baseline by more than threshold, returning their number.
+    size_t compare(const results_t &results, const results_t &baseline, double threshold) {
+        size_t regressions = 0;
+        for (const auto &[name, base] : baseline) {
+            auto it = results.find(name);
+            if (it == results.end() || base <= 0) {
+                continue;
+            }
+            double change = lower_is_better(name) ? it->second / base - 1 : base / it->second - 1;
+            if (change > threshold) {
+                std::printf("REGRESSION %-37s %16.1f -> %.1f (%+.1f%%)\n", name.c_str(), base,
+                            it->second, change * 100);
+                ++regressions;
+            }
+        }
+        return regressions;
+    }
+
+    Options parse_options(int argc, char *argv[]) {
+        Options options;
+        for (int i = 1; i < argc; i += 2) {
+            std::string option = argv[i];
+            if (i + 1 == argc) {
+                // Option missing its value matches none of those below.
+                option += " without value";
+            }
+            if (option == "--scale") {
+                options.scale = std::max<size_t>(1, std::strtoull(argv[i + 1], nullptr, 10));
+            } else if (option == "--json") {
+                options.json = argv[i + 1];
+            } else if (option == "--baseline") {
+                options.baseline = argv[i + 1];
+            } else if (option == "--threshold") {
+                options.threshold = std::strtod(argv[i + 1], nullptr);
+            } else {
+                std::fprintf(stderr, "Unknown option %s\n", option.c_str());
+                std::exit(2);
+            }
+        }
+        return options;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options options = parse_options(argc, argv);
+    size_t n = 20000 * options.scale;
+    results_t results;
+
+    std::vector<Workload> workloads;
+    workloads.push_back(mov_runs(n));
+    workloads.push_back(deep_chains(n / 16, 32));
+    workloads.push_back(declarations(n / 4));
+    workloads.push_back(arithmetic(n));
+    workloads.push_back(large_memory(n / 4));
+    for (const Workload &w : workloads) {
+        bench_engines(w, 11, results);
+    }
+
+    bench_scheduler(arithmetic(64 * n), mov_runs(256), 64, results);
+    bench_incremental(arithmetic(16 * n), results);
+
+    bench_memory(Memory::mem_size_t(1) << 20, computer::Backing::Dense, "dense_1M", results);
+    bench_memory(Memory::mem_size_t(1) << 20, computer::Backing::Paged, "paged_1M", results);
+    bench_memory(Memory::mem_size_t(1) << 32, computer::Backing::Paged, "paged_4G", results);
+    bench_dump(Memory::mem_size_t(1) << 20, results);
+    bench_identifiers(300000 * options.scale, results);
+
+    std::string source = generate_source(options.scale << 22);
+    bench_assembler(source, 1, results);
+    size_t hardware = std::thread::hardware_concurrency();
+    if (hardware > 1) {
+        bench_assembler(source, hardware, results);
+    }
+
+    if (!options.json.empty()) {
+        write_json(results, options.json);
+    }
+    if (!options.baseline.empty()) {
+        return compare(results, read_json(options.baseline), options.threshold) > 0 ? 1 : 0;
+    }
+    return 0;
+}
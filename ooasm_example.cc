@@ -1,8 +1,30 @@
 #include "ooasm.h"
 #include "computer.h"
+#include "static_ooasm.h"
+#include "binary_format.h"
+#include "optimizer.h"
+#include "lockstep.h"
+#include "fleet.h"
+#include "scheduler.h"
+#include "assembler.h"
+#include "incremental.h"
 #include <string>
 #include <sstream>
 #include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace {
     std::string memory_dump(Computer const& computer) {
@@ -10,6 +32,284 @@ namespace {
         computer.memory_dump(ss);
         return ss.str();
     }
+
+    template <size_t Size>
+    std::string memory_dump(ooasm::ct::Computer<Size> const& computer) {
+        std::stringstream ss;
+        computer.memory_dump(ss);
+        return ss.str();
+    }
+
+    template <size_t Size, typename Program>
+    constexpr ooasm::ct::Computer<Size> booted(Program const& p) {
+        ooasm::ct::Computer<Size> computer;
+        computer.boot(p);
+        return computer;
+    }
+
+    // Memory of computer followed by its flags.
+    template <typename C>
+    std::string state(C const& computer) {
+        std::stringstream ss;
+        computer.memory_dump(ss);
+        auto snapshot = computer.snapshot();
+        ss << "ZF=" << snapshot.ZF << " SF=" << snapshot.SF;
+        return ss.str();
+    }
+
+    // State in which <boot> leaves computer, followed by exception which stopped it, if any.
+    template <typename C, typename Boot>
+    std::string outcome(C& computer, Boot boot) {
+        std::string error;
+        try {
+            boot(computer);
+        } catch (std::exception const& e) {
+            error = e.what();
+        }
+        return state(computer) + " " + error;
+    }
+
+    // Boots program twice with tree engine and with <boot>, each on its own computer, and
+    // asserts that both leave the same state after each boot, so that flags kept by the first
+    // boot count too.
+    template <typename Boot>
+    void assert_like_tree(ooasm::Program const& p, size_t mem_size, Boot boot) {
+        Computer expected(mem_size);
+        Computer actual(mem_size);
+        for (int i = 0; i < 2; ++i) {
+            assert(outcome(expected, [&](Computer& c) { c.boot(p); }) == outcome(actual, boot));
+        }
+    }
+
+    // Programs together with size of memory to boot them on, covering every instruction,
+    // flags read before being set and faults stopping program in the middle.
+    std::vector<std::pair<ooasm::Program, size_t>> samples() {
+        std::vector<std::pair<ooasm::Program, size_t>> result;
+        result.emplace_back(program({
+            data("a", num(4)),
+            data("b", num(4)),
+            sub(mem(lea("a")), mem(lea("b"))),
+            onez(mem(num(2))),
+            ones(mem(num(3))),
+            add(mem(lea("b")), num(-9)),
+            ones(mem(num(4))),
+            one(mem(lea("a")))
+        }), 5);
+        result.emplace_back(program({
+            onez(mem(num(0))),
+            ones(mem(num(1))),
+            dec(mem(num(2)))
+        }), 3);
+        result.emplace_back(program({
+            data("p", num(3)),
+            mov(mem(mem(lea("p"))), num(7)),
+            sub(mem(lea("p")), num(10)),
+            inc(mem(num(1))),
+            mov(mem(mem(lea("p"))), num(1)),
+            inc(mem(num(2)))
+        }), 4);
+        result.emplace_back(program({
+            dec(mem(num(0))),
+            mov(mem(num(4)), num(1)),
+            inc(mem(num(1)))
+        }), 4);
+        result.emplace_back(program({
+            data("a", num(1)),
+            data("b", num(2)),
+            data("c", num(3))
+        }), 2);
+        return result;
+    }
+
+    // Boots program twice on computer and on lockstep computer of the same word width, and
+    // asserts that every lane ends each boot in the same state as computer.
+    template <typename Word>
+    void assert_lockstep_like_computer(ooasm::Program const& p, size_t mem_size) {
+        ooasm::Bytecode code(p);
+        computer::BasicComputer<Word> expected(mem_size);
+        // More lanes than vector register holds, so that scalar code runs the rest.
+        computer::BasicLockstepComputer<Word> lockstep(40, mem_size);
+        for (int i = 0; i < 2; ++i) {
+            std::string expected_outcome =
+                    outcome(expected, [&](computer::BasicComputer<Word>& c) { c.boot(code); });
+            auto errors = lockstep.boot(code);
+            for (size_t lane = 0; lane < lockstep.lanes(); ++lane) {
+                std::stringstream ss;
+                lockstep.memory_dump(lane, ss);
+                ss << "ZF=" << lockstep.getZF(lane) << " SF=" << lockstep.getSF(lane) << " ";
+                try {
+                    if (errors[lane]) {
+                        std::rethrow_exception(errors[lane]);
+                    }
+                } catch (std::exception const& e) {
+                    ss << e.what();
+                }
+                assert(ss.str() == expected_outcome);
+            }
+        }
+    }
+
+    // Words wrap around at their width, setting flags of wrapped result, and negative word
+    // used as address faults.
+    template <typename Word>
+    void assert_width() {
+        auto max = static_cast<ooasm::word_t>(std::numeric_limits<Word>::max());
+        auto p = program({
+            data("p", num(max)),
+            inc(mem(lea("p"))),
+            ones(mem(num(1))),
+            mov(mem(num(2)), num(max)),
+            add(mem(num(2)), num(max)),
+            mov(mem(mem(lea("p"))), num(1)),
+            one(mem(num(1)))
+        });
+        computer::BasicComputer<Word> c(3);
+        bool faulted = false;
+        try {
+            c.boot(p);
+        } catch (computer::Memory::OutOfRangeMemoryAccessException const&) {
+            faulted = true;
+        }
+        assert(faulted);
+        assert(state(c) ==
+               std::to_string(std::numeric_limits<Word>::min()) + " 1 -2 ZF=0 SF=1");
+        assert_lockstep_like_computer<Word>(p, 3);
+
+        // Lanes starting from different words, some of which wrap to zero or to negative.
+        using arithmetic_t = computer::WordArithmetic<Word>;
+        computer::BasicLockstepComputer<Word> lockstep(40, 1);
+        std::vector<Word> words;
+        for (size_t lane = 0; lane < lockstep.lanes(); ++lane) {
+            words.push_back(arithmetic_t::wrap(lane * 0x0123456789abcdefULL));
+        }
+        words[5] = -1;
+        words[7] = std::numeric_limits<Word>::max();
+        for (size_t lane = 0; lane < lockstep.lanes(); ++lane) {
+            lockstep.set(lane, 0, words[lane]);
+        }
+        lockstep.run(ooasm::Bytecode(program({inc(mem(num(0)))})));
+        for (size_t lane = 0; lane < lockstep.lanes(); ++lane) {
+            Word result = arithmetic_t::add(words[lane], 1);
+            assert(lockstep.at(lane, 0) == result);
+            assert(lockstep.getZF(lane) == (result == 0) && lockstep.getSF(lane) == (result < 0));
+        }
+
+        for (auto const& [sample, size] : samples()) {
+            assert_lockstep_like_computer<Word>(sample, size);
+        }
+    }
+
+    // Bytecode of instructions which are not linked, so that their identifiers are looked up
+    // in memory which runs it, e.g. one restored from snapshot.
+    ooasm::Bytecode unlinked(
+            std::vector<std::shared_ptr<ooasm::Instruction>> const& instructions) {
+        ooasm::Bytecode code;
+        for (auto const& ins : instructions) {
+            ins->compile(code);
+        }
+        return code;
+    }
+
+    // Boot of two slices, the first of which signals <started> and waits for <open>.
+    BootTask blocking(std::promise<void>& started, std::shared_future<void> open) {
+        started.set_value();
+        open.wait();
+        co_await std::suspend_always();
+    }
+
+    // Boot of <slices> slices, each appending <name> to <order>.
+    BootTask counting(std::string& order, char name, int slices) {
+        for (int i = 0; i < slices; ++i) {
+            order += name;
+            co_await std::suspend_always();
+        }
+    }
+
+    // Incremental computer together with instructions which it boots, edited alike, whose
+    // boot asserts that it leaves the same state as boot of instructions on new computer.
+    class Edited {
+    public:
+        using instructions_t = std::vector<IncrementalComputer::instruction_ptr>;
+
+        Edited(instructions_t _instructions, size_t _mem_size, size_t interval)
+                : instructions(std::move(_instructions)), mem_size(_mem_size),
+                  incremental(mem_size, ooasm::Program(instructions_t(instructions)), interval) {}
+
+        void insert(size_t position, IncrementalComputer::instruction_ptr ins) {
+            instructions.insert(instructions.begin() + static_cast<std::ptrdiff_t>(position), ins);
+            incremental.insert(position, std::move(ins));
+        }
+
+        void erase(size_t position) {
+            instructions.erase(instructions.begin() + static_cast<std::ptrdiff_t>(position));
+            incremental.erase(position);
+        }
+
+        void replace(size_t position, IncrementalComputer::instruction_ptr ins) {
+            instructions[position] = ins;
+            incremental.replace(position, std::move(ins));
+        }
+
+        // Outcome of boot, which is asserted to be that of new computer.
+        std::string boot() {
+            ooasm::Program p{instructions_t(instructions)};
+            Computer expected(mem_size);
+            std::string result = outcome(expected, [&](Computer& c) { c.boot(p); });
+            assert(outcome(incremental, [](IncrementalComputer& c) { c.boot(); }) == result);
+            return result;
+        }
+
+    private:
+        instructions_t instructions;
+        size_t mem_size;
+        IncrementalComputer incremental;
+    };
+
+    // Contents of precompiled program file.
+    std::string saved(ooasm::Bytecode const& code) {
+        std::stringstream ss;
+        ooasm::BinaryFormat::save(code, ss);
+        return ss.str();
+    }
+
+    // Bytecode loaded from file contents, copied to buffer aligned as ops are.
+    ooasm::Bytecode loaded(std::string const& file) {
+        std::shared_ptr<uint64_t[]> words(new uint64_t[file.size() / sizeof(uint64_t) + 1]);
+        std::memcpy(words.get(), file.data(), file.size());
+        return ooasm::BinaryFormat::load(std::shared_ptr<void const>(words, words.get()),
+                                         file.size());
+    }
+
+    bool rejected(std::string const& file) {
+        try {
+            static_cast<void>(loaded(file));
+        } catch (ooasm::BinaryFormat::InvalidFileException const&) {
+            return true;
+        }
+        return false;
+    }
+
+    namespace ct = ooasm::ct;
+
+    constexpr auto ct_operations = ct::program(
+        ct::data("a", ct::num(4)),
+        ct::data("b", ct::num(3)),
+        ct::data("c", ct::num(2)),
+        ct::data("d", ct::num(1)),
+        ct::add(ct::mem(ct::lea("a")), ct::mem(ct::lea("c"))),
+        ct::sub(ct::mem(ct::lea("b")), ct::mem(ct::lea("d"))),
+        ct::mov(ct::mem(ct::lea("c")), ct::num(0)),
+        ct::mov(ct::mem(ct::lea("d")), ct::num(0))
+    );
+    static_assert(booted<5>(ct_operations).at(0) == 6);
+    static_assert(booted<5>(ct_operations).at(1) == 2);
+
+    constexpr auto ct_ones = ct::program(
+        ct::dec(ct::mem(ct::num(1))),
+        ct::ones(ct::mem(ct::mem(ct::lea("p")))),
+        ct::data("p", ct::num(0))
+    );
+    static_assert(booted<2>(ct_ones).at(0) == 1 && booted<2>(ct_ones).getSF());
 }
 
 int main() {
@@ -51,4 +351,799 @@ int main() {
     Computer computer4(5);
     computer4.boot(ooasm_operations);
     assert(memory_dump(computer4) == "6 2 0 0 0 ");
+
+    ooasm::ct::Computer<5> static_computer4;
+    static_computer4.boot(ct_operations);
+    assert(memory_dump(static_computer4) == memory_dump(computer4));
+
+    for (auto const& [p, size] : samples()) {
+        assert_like_tree(p, size, [&](Computer& c) { c.boot(p, computer::Engine::Bytecode); });
+        assert_like_tree(p, size, [&](Computer& c) { c.boot(ooasm::Bytecode(p)); });
+        assert_like_tree(p, size, [&](Computer& c) { c.boot(p, computer::Engine::Jit); });
+        assert(p.jit().get(size) != nullptr && p.jit().get(size + 1) == nullptr);
+        auto jit = p.jit().get(size);
+        assert_like_tree(p, size, [&](Computer& c) { c.boot(p, computer::Engine::Jit); });
+        assert(p.jit().get(size) == jit);
+        computer::JitProgram unverified(ooasm::Bytecode(p), size);
+        assert(unverified.compiled() == bool(OOASM_JIT));
+        assert_like_tree(p, size, [&](Computer& c) { c.boot(unverified); });
+        for (size_t verified_size : {size, size + 1}) {
+            ooasm::Bytecode code(p);
+            ooasm::verify(code, verified_size);
+            assert(ooasm::sound(code, verified_size));
+            assert_like_tree(p, size, [&](Computer& c) { c.boot(code); });
+            computer::JitProgram verified(code, size);
+            assert_like_tree(p, size, [&](Computer& c) { c.boot(verified); });
+        }
+    }
+
+    for (auto const& [p, size] : samples()) {
+        ooasm::Bytecode code(p);
+        ooasm::verify(code, size);
+        std::string file = saved(code);
+        ooasm::Bytecode loaded_code = loaded(file);
+        assert(loaded_code.verified_for(size));
+        assert(saved(loaded_code) == file);
+        assert_like_tree(p, size, [&](Computer& c) { c.boot(loaded_code); });
+    }
+
+    assert_width<int8_t>();
+    assert_width<int16_t>();
+    assert_width<int32_t>();
+    assert_width<int64_t>();
+
+    // Optimized bytecode has to be verified again before it is booted.
+    auto optimized_boot = [](ooasm::Program const& p, size_t size) {
+        ooasm::Bytecode code(p);
+        size_t removed = ooasm::optimize(code, size);
+        ooasm::verify(code, size);
+        assert_like_tree(p, size, [&](Computer& c) { c.boot(code); });
+        return removed;
+    };
+    for (auto const& [p, size] : samples()) {
+        optimized_boot(p, size);
+    }
+    auto fused = program({
+        inc(mem(num(0))),
+        add(mem(num(0)), num(5)),
+        sub(mem(num(0)), num(10)),
+        dec(mem(num(0)))
+    });
+    assert(optimized_boot(fused, 1) == 3);
+    auto dead_stores = program({
+        mov(mem(num(0)), num(1)),
+        one(mem(num(0))),
+        mov(mem(num(0)), num(3))
+    });
+    assert(optimized_boot(dead_stores, 1) == 2);
+    // Store before faulting op is observed, even though it is overwritten later.
+    auto fault_barrier = program({
+        data("p", num(7)),
+        mov(mem(num(1)), num(1)),
+        mov(mem(mem(lea("p"))), num(2)),
+        mov(mem(num(1)), num(3))
+    });
+    assert(optimized_boot(fault_barrier, 2) == 0);
+
+    for (auto const& [p, size] : samples()) {
+        ooasm::PartialProgram partial(ooasm::Bytecode(p), size);
+        assert_like_tree(p, size, [&](Computer& c) { c.boot(partial); });
+        // Memory of other size boots whole program.
+        ooasm::PartialProgram other_size(ooasm::Bytecode(p), size + 1);
+        assert_like_tree(p, size, [&](Computer& c) { c.boot(other_size); });
+    }
+    auto residual_fault = program({
+        data("a", num(1)),
+        add(mem(lea("a")), num(2)),
+        one(mem(num(1))),
+        mov(mem(mem(lea("a"))), num(4)),
+        inc(mem(num(1)))
+    });
+    ooasm::PartialProgram partial(ooasm::Bytecode(residual_fault), 2);
+    assert(partial.evaluated() == 2);
+    assert_like_tree(residual_fault, 2, [&](Computer& c) { c.boot(partial); });
+    // Snapshot taken after partial boot is of state it left rather than of the one before.
+    ooasm::PartialProgram constant(
+            ooasm::Bytecode(program({data("a", num(3)), inc(mem(lea("a")))})), 1);
+    Computer evaluated(1);
+    assert(state(Computer(evaluated.snapshot())) == "0 ZF=0 SF=0");
+    evaluated.boot(constant);
+    assert(state(Computer(evaluated.snapshot())) == "4 ZF=0 SF=0");
+
+    // Flags left by parallel segment are those of its last arithmetic op, which is in other
+    // chain than the first one, and onez and ones read them. Those at the start read flags of
+    // previous boot.
+    std::vector<std::shared_ptr<ooasm::Instruction>> chains = {
+        ones(mem(num(11))),
+        onez(mem(num(12)))
+    };
+    for (size_t i = 0; i < ParallelProgram::MIN_PARALLEL_OPS; ++i) {
+        chains.push_back(inc(mem(num(static_cast<ooasm::word_t>(i % 8)))));
+    }
+    chains.push_back(sub(mem(num(3)), num(1 << 20)));
+    chains.push_back(onez(mem(num(8))));
+    chains.push_back(ones(mem(num(9))));
+    ooasm::Program ooasm_chains(std::move(chains));
+    ParallelProgram parallel(ooasm::Bytecode(ooasm_chains), 16);
+    assert(parallel.segments().size() == 1);
+    assert(parallel.segments()[0].parallel && *parallel.segments()[0].flags_chain > 0);
+    computer::ThreadPool pool(2);
+    assert_like_tree(ooasm_chains, 16, [&](Computer& c) { c.boot(parallel, pool); });
+
+    // Replay of traced boot up to op, and rewind back to it of memory in state boot left, give
+    // state of boot of program cut short before that op. The second boot starts with flags
+    // the first one left.
+    std::vector<std::shared_ptr<ooasm::Instruction>> traced_ops = {
+        add(mem(lea("a")), num(3)),
+        mov(mem(num(2)), mem(lea("a"))),
+        sub(mem(num(3)), num(1)),
+        onez(mem(num(0))),
+        ones(mem(num(1))),
+        inc(mem(num(3))),
+        onez(mem(num(2))),
+        dec(mem(num(1)))
+    };
+    auto prefix = [&](size_t length) {
+        std::vector<std::shared_ptr<ooasm::Instruction>> ins = {data("a", num(5))};
+        ins.insert(ins.end(), traced_ops.begin(),
+                   traced_ops.begin() + static_cast<std::ptrdiff_t>(length));
+        return ooasm::Program(std::move(ins));
+    };
+    std::string trace_path =
+            (std::filesystem::temp_directory_path() / "ooasm_example.trace").string();
+    Computer traced(4);
+    traced.trace(trace_path);
+    traced.boot(prefix(traced_ops.size()));
+    traced.boot(prefix(traced_ops.size()));
+    traced.stop_trace();
+    computer::TraceReplay trace(trace_path);
+    assert(trace.boots() == 2);
+    for (size_t boot = 0; boot < 2; ++boot) {
+        Computer finished(4);
+        finished.replay(trace, boot, traced_ops.size());
+        for (size_t index = 0; index <= traced_ops.size(); ++index) {
+            Computer expected(4);
+            if (boot == 1) {
+                expected.boot(prefix(traced_ops.size()));
+            }
+            expected.boot(prefix(index));
+            Computer replayed(4);
+            replayed.replay(trace, boot, index);
+            assert(state(replayed) == state(expected));
+            Computer rewound(finished.snapshot());
+            rewound.rewind(trace, boot, index);
+            assert(state(rewound) == state(expected));
+        }
+    }
+    std::remove(trace_path.c_str());
+
+    // Flags of arithmetic op before fault are observed, as are those of the last op, by the
+    // next boot, even though ops after them would overwrite them.
+    auto flags_at_fault = program({
+        add(mem(num(0)), num(-1)),
+        mov(mem(num(5)), num(1)),
+        inc(mem(num(0)))
+    });
+    auto flags_at_end = program({
+        ones(mem(num(1))),
+        onez(mem(num(2))),
+        add(mem(num(0)), num(-3)),
+        sub(mem(num(0)), num(-3))
+    });
+    for (auto const& p : {flags_at_fault, flags_at_end}) {
+        ooasm::Bytecode code(p);
+        ooasm::verify(code, 3);
+        assert(ooasm::sound(code, 3));
+        computer::JitProgram jit(code, 3);
+        ParallelProgram parallel_flags(code, 3);
+        assert_like_tree(p, 3, [&](Computer& c) { c.boot(code); });
+        assert_like_tree(p, 3, [&](Computer& c) { c.boot(jit); });
+        assert_like_tree(p, 3, [&](Computer& c) { c.boot(parallel_flags, pool); });
+    }
+    ooasm::Bytecode fault_code(flags_at_fault);
+    ooasm::verify(fault_code, 3);
+    assert(ooasm::dead_flags(fault_code.code()) == std::vector<bool>({false, false, false}));
+    ooasm::Bytecode end_code(flags_at_end);
+    ooasm::verify(end_code, 3);
+    assert(ooasm::dead_flags(end_code.code()) ==
+           std::vector<bool>({false, false, true, false}));
+    // Marks claiming flags nothing observes where they are observed.
+    for (ooasm::Bytecode* code : {&fault_code, &end_code}) {
+        for (ooasm::Bytecode::Op& op : code->mutable_code()) {
+            op.flags_dead = true;
+        }
+        code->mark_verified(3);
+        assert(!ooasm::sound(*code, 3));
+    }
+
+    // Scheduler with single thread, whose boots submitted while it runs blocking one start in
+    // order determined by priorities alone.
+    {
+        using Status = Scheduler::Status;
+        ooasm::Bytecode increments(program({inc(mem(num(0))), inc(mem(num(0)))}));
+        ooasm::Bytecode faulting(program({inc(mem(num(0))), mov(mem(num(3)), num(1))}));
+        Computer cancelled_computer(1);
+        Computer done_computer(1);
+        Computer failed_computer(1);
+        std::string order;
+        Scheduler scheduler(1, 1);
+        std::promise<void> started;
+        std::promise<void> open;
+        Scheduler::Job running = scheduler.submit(blocking(started, open.get_future().share()));
+        started.get_future().wait();
+        Scheduler::Job queued = scheduler.submit(cancelled_computer, increments);
+        Scheduler::Job done = scheduler.submit(done_computer, increments);
+        Scheduler::Job failed = scheduler.submit(failed_computer, faulting);
+        Scheduler::Job high = scheduler.submit(counting(order, 'h', 8), 4);
+        Scheduler::Job low = scheduler.submit(counting(order, 'l', 4));
+        assert(scheduler.cancel(queued) && queued.status() == Status::Cancelled);
+        assert(!queued.wait());
+        assert(scheduler.cancel(running) && running.status() == Status::Pending);
+        open.set_value();
+        assert(!running.wait() && running.status() == Status::Cancelled);
+        assert(done.wait() && done.status() == Status::Done);
+        bool thrown = false;
+        try {
+            failed.wait();
+        } catch (computer::Memory::OutOfRangeMemoryAccessException const&) {
+            thrown = true;
+        }
+        assert(thrown && failed.status() == Status::Failed);
+        assert(high.wait() && low.wait());
+        assert(!scheduler.cancel(done));
+        assert(memory_dump(cancelled_computer) == "0 ");
+        assert(memory_dump(done_computer) == "2 ");
+        assert(memory_dump(failed_computer) == "1 ");
+        // Boots start at the same virtual time, after which boot with four times higher
+        // priority gets four slices for every slice of the other.
+        assert(order == "hlhhhlhhhhll");
+    }
+    {
+        using Status = Scheduler::Status;
+        ooasm::Bytecode increments(program({inc(mem(num(0)))}));
+        Computer pending_computer(1);
+        std::promise<void> started;
+        std::promise<void> open;
+        std::optional<Scheduler::Job> running;
+        std::optional<Scheduler::Job> queued;
+        std::thread opener;
+        {
+            Scheduler scheduler(1, 1);
+            running = scheduler.submit(blocking(started, open.get_future().share()));
+            started.get_future().wait();
+            queued = scheduler.submit(pending_computer, increments);
+            // Blocking boot finishes its slice only once scheduler is being destroyed.
+            opener = std::thread([&] {
+                while (queued->status() == Status::Pending) {
+                    std::this_thread::yield();
+                }
+                open.set_value();
+            });
+        }
+        opener.join();
+        assert(running->status() == Status::Cancelled && !running->wait());
+        assert(queued->status() == Status::Cancelled);
+        assert(memory_dump(pending_computer) == "0 ");
+    }
+
+    // Boots restoring image of memory after declarations, which the first boot of program or
+    // bytecode caches, leave the same state as the first boot, whatever is in memory before.
+    auto cached = [] {
+        return program({
+            data("a", num(3)),
+            data("b", num(-4)),
+            add(mem(lea("a")), mem(lea("b"))),
+            ones(mem(num(4))),
+            mov(mem(num(5)), mem(lea("a")))
+        });
+    };
+    std::vector<std::shared_ptr<ooasm::Instruction>> overwrites;
+    for (ooasm::word_t i = 0; i < 8; ++i) {
+        overwrites.push_back(mov(mem(num(i)), num(7)));
+    }
+    ooasm::Program overwriting(std::move(overwrites));
+    auto cached_p = cached();
+    ooasm::Bytecode cached_code(cached_p);
+    std::string first_boot;
+    for (auto const& boot : std::vector<std::function<void(Computer&)>>{
+            [&](Computer& c) { c.boot(cached_p); },
+            [&](Computer& c) { c.boot(cached_code); }}) {
+        Computer c(8);
+        boot(c);
+        std::string first = state(c);
+        assert(first_boot.empty() || first == first_boot);
+        first_boot = first;
+        c.boot(overwriting);
+        boot(c);
+        assert(state(c) == first);
+    }
+    assert(cached_p.boot_image().get() != nullptr && cached_code.boot_image().get() != nullptr);
+    // Image of two variables cached on large memory is reused on smaller one.
+    auto reused_p = cached();
+    Computer large(1 << 16);
+    large.boot(reused_p);
+    auto image = reused_p.boot_image().get();
+    Computer small(6);
+    small.boot(reused_p);
+    assert(reused_p.boot_image().get() == image);
+    auto uncached_p = cached();
+    Computer uncached(6);
+    uncached.boot(uncached_p);
+    assert(state(small) == state(uncached));
+    // Boots with other engines compile program to bytecode sharing its image.
+    auto engines_p = cached();
+    Computer engines(8);
+    engines.boot(engines_p, computer::Engine::Bytecode);
+    auto engines_image = engines_p.boot_image().get();
+    assert(engines_image != nullptr && state(engines) == first_boot);
+    engines.boot(overwriting);
+    engines.boot(engines_p, computer::Engine::Bytecode);
+    assert(engines_p.boot_image().get() == engines_image && state(engines) == first_boot);
+    engines.boot(overwriting);
+    engines.boot(engines_p, computer::Engine::Jit);
+    assert(engines_p.boot_image().get() == engines_image && state(engines) == first_boot);
+    assert(&ooasm::Bytecode(engines_p).boot_image() == &engines_p.boot_image());
+    // Declaration added to copy of bytecode does not change image shared with original.
+    ooasm::Bytecode declaring = cached_code;
+    assert(&declaring.boot_image() == &cached_code.boot_image());
+    declaring.declare("c", 5);
+    assert(&declaring.boot_image() != &cached_code.boot_image());
+    assert(declaring.boot_image().get() == nullptr && cached_code.boot_image().get() != nullptr);
+    Computer declared(8);
+    declared.boot(declaring);
+    assert(memory_dump(declared) == "-1 -4 5 0 1 -1 0 0 ");
+    declared.boot(cached_code);
+    assert(memory_dump(declared) == "-1 -4 0 0 1 -1 0 0 ");
+
+    // Edits of incremental computer, booted with checkpoints every few ops, so that boots
+    // restart and converge at various checkpoints.
+    Edited::instructions_t counters = {
+        data("x", num(1)),
+        data("y", num(0)),
+        inc(mem(lea("x"))),
+        add(mem(lea("y")), mem(lea("x"))),
+        inc(mem(num(2))),
+        add(mem(num(3)), mem(num(2))),
+        mov(mem(num(4)), num(5)),
+        dec(mem(num(4))),
+        add(mem(num(2)), mem(num(4))),
+        inc(mem(num(5))),
+        sub(mem(num(5)), num(3)),
+        add(mem(num(3)), num(1)),
+        add(mem(lea("y")), mem(num(3)))
+    };
+    for (size_t interval : {1, 2, 3}) {
+        // Insert before range changed by edit not booted yet.
+        Edited before(counters, 6, interval);
+        before.boot();
+        before.replace(10, sub(mem(num(5)), num(4)));
+        before.insert(3, inc(mem(lea("x"))));
+        before.boot();
+        before.insert(12, inc(mem(num(4))));
+        before.insert(12, dec(mem(num(4))));
+        before.boot();
+
+        // Erase of the last op changed and of ops right after it.
+        Edited across(counters, 6, interval);
+        across.boot();
+        across.insert(6, inc(mem(num(4))));
+        across.erase(7);
+        across.erase(6);
+        across.erase(6);
+        across.boot();
+        across.insert(4, dec(mem(num(5))));
+        across.erase(4);
+        across.erase(3);
+        across.boot();
+
+        // Several edits between boots, some of which undo others.
+        Edited several(counters, 6, interval);
+        several.boot();
+        several.replace(5, add(mem(num(3)), mem(num(4))));
+        several.insert(9, inc(mem(num(3))));
+        several.erase(2);
+        several.replace(7, add(mem(num(2)), num(2)));
+        several.insert(11, inc(mem(num(0))));
+        several.boot();
+        several.erase(10);
+        several.replace(4, add(mem(num(3)), mem(num(2))));
+        several.insert(1, data("z", num(7)));
+        several.replace(8, inc(mem(lea("z"))));
+        several.boot();
+        several.boot();
+
+        // Edit of declarations, before and after edits of ops.
+        Edited declarations(counters, 6, interval);
+        declarations.boot();
+        declarations.replace(8, inc(mem(lea("y"))));
+        declarations.replace(0, data("x", num(4)));
+        declarations.insert(9, dec(mem(lea("x"))));
+        declarations.boot();
+        declarations.insert(2, data("w", num(-3)));
+        declarations.insert(14, add(mem(lea("w")), mem(lea("x"))));
+        declarations.boot();
+        declarations.erase(14);
+        declarations.erase(2);
+        declarations.boot();
+
+        // Program faulting before edits and after them.
+        Edited faulting({
+            data("p", num(9)),
+            inc(mem(num(1))),
+            inc(mem(num(2))),
+            mov(mem(mem(lea("p"))), num(1)),
+            inc(mem(num(3))),
+            add(mem(num(2)), mem(num(1))),
+            inc(mem(num(4))),
+            dec(mem(num(3)))
+        }, 6, interval);
+        std::string fault = faulting.boot();
+        faulting.replace(6, dec(mem(num(4))));
+        assert(faulting.boot() == fault);
+        faulting.insert(1, sub(mem(lea("p")), num(4)));
+        std::string moved = faulting.boot();
+        assert(moved != fault);
+        faulting.insert(9, add(mem(lea("p")), num(5)));
+        faulting.insert(10, mov(mem(mem(lea("p"))), num(2)));
+        faulting.boot();
+        faulting.replace(2, dec(mem(num(1))));
+        faulting.boot();
+        faulting.erase(1);
+        faulting.boot();
+
+        // Edits which the rest of program undoes, so that boot converges with the previous
+        // one, at checkpoints moved by all edits since.
+        Edited::instructions_t resets = {
+            mov(mem(num(0)), num(3)),
+            inc(mem(num(1))),
+            mov(mem(num(2)), num(7)),
+            add(mem(num(3)), mem(num(1))),
+            add(mem(num(3)), mem(num(1)))
+        };
+        Edited shifted(resets, 4, interval);
+        shifted.boot();
+        shifted.insert(0, inc(mem(num(1))));
+        shifted.insert(0, mov(mem(num(0)), mem(num(0))));
+        shifted.boot();
+        Edited extended(resets, 4, interval);
+        extended.boot();
+        extended.replace(0, mov(mem(num(0)), num(3)));
+        extended.replace(1, dec(mem(num(1))));
+        extended.insert(1, mov(mem(num(0)), mem(num(0))));
+        extended.boot();
+        Edited converging({
+            data("p", num(9)),
+            add(mem(num(1)), num(2)),
+            mov(mem(num(1)), num(0)),
+            inc(mem(num(2))),
+            inc(mem(num(3))),
+            mov(mem(mem(lea("p"))), num(1))
+        }, 4, interval);
+        fault = converging.boot();
+        converging.replace(1, add(mem(num(1)), num(4)));
+        assert(converging.boot() == fault);
+
+        // Erase of op before declaration, and then of declaration.
+        Edited undeclared({
+            inc(mem(num(0))),
+            data("z", num(5)),
+            inc(mem(num(0))),
+            inc(mem(num(1)))
+        }, 2, interval);
+        undeclared.boot();
+        undeclared.erase(0);
+        undeclared.erase(0);
+        undeclared.boot();
+    }
+
+    // Table of identifiers growing with keys which all start in the same slot, rejecting
+    // duplicates and keeping aside identifiers which do not pack.
+    computer::IdTable table;
+    std::vector<std::string> colliding;
+    for (size_t i = 0; colliding.size() < 40; ++i) {
+        std::string id = "k" + std::to_string(i);
+        if ((computer::PackedId(id).hash() & 15) == 0) {
+            colliding.push_back(id);
+        }
+    }
+    for (size_t i = 0; i < colliding.size(); ++i) {
+        assert(table.try_emplace(colliding[i], i));
+        assert(!table.try_emplace(colliding[i], i + 100));
+    }
+    std::string unpacked(computer::PackedId::MAX_LENGTH + 1, 'u');
+    assert(table.try_emplace(unpacked, 7) && !table.try_emplace(unpacked, 8));
+    assert(table.try_emplace("", 9));
+    assert(table.size() == colliding.size() + 2);
+    for (size_t i = 0; i < colliding.size(); ++i) {
+        assert(table.find(colliding[i]) != nullptr && *table.find(colliding[i]) == i);
+    }
+    assert(*table.find(unpacked) == 7 && *table.find("") == 9 && table.find("k") == nullptr);
+    std::map<std::string, computer::IdTable::value_t> visited;
+    table.for_each([&](std::string const& id, computer::IdTable::value_t value) {
+        assert(visited.emplace(id, value).second);
+    });
+    assert(visited.size() == table.size() && visited[unpacked] == 7 && visited[""] == 9);
+    for (size_t i = 0; i < colliding.size(); ++i) {
+        assert(visited[colliding[i]] == i);
+    }
+    table.clear();
+    assert(table.size() == 0 && table.find(colliding[0]) == nullptr &&
+           table.find(unpacked) == nullptr);
+    assert(table.try_emplace(colliding[1], 5) && table.try_emplace(unpacked, 6));
+    assert(*table.find(colliding[1]) == 5 && *table.find(unpacked) == 6 && table.size() == 2);
+
+    // Assembled source boots like the same program of language elements. Identifiers may be
+    // quoted or bare, and comments, blank lines and trailing commas are skipped.
+    Assembler assembler(4);
+    auto assembled = assembler.assemble(
+            "// Sample with flags read by later instructions.\n"
+            "data(\"a\", num(4)),\n"
+            "data(b, num(4))\n"
+            "\n"
+            "  sub(mem(lea(a)), mem(lea(\"b\")))   // a - b is zero\n"
+            "onez( mem( num(2) ) ),\n"
+            "ones(mem(num(3)))\n"
+            "add(mem(lea(b)), num(-9)),\n"
+            "ones(mem(num(4)))\n"
+            "one(mem(lea(\"a\")))");
+    auto assembled_samples = samples();
+    Computer assembled_computer(assembled_samples.front().second);
+    Computer assembled_like(assembled_samples.front().second);
+    for (int i = 0; i < 2; ++i) {
+        assert(outcome(assembled_computer, [&](Computer& c) { c.boot(assembled); }) ==
+               outcome(assembled_like, [&](Computer& c) {
+                   c.boot(assembled_samples.front().first);
+               }));
+    }
+    auto syntax_error = [&](std::string const& source) {
+        try {
+            static_cast<void>(assembler.assemble(source));
+        } catch (Assembler::SyntaxError const& e) {
+            return std::to_string(e.line()) + ":" + std::to_string(e.column()) + " " +
+                   e.problem();
+        }
+        return std::string();
+    };
+    assert(syntax_error("data(abcdefghij, num(1))\ninc(mem(lea(abcdefghij)))\n").empty());
+    assert(syntax_error("data(a, num(1))\ndata( abcdefghijk, num(1))") ==
+           "2:7 identifier has to have between 1 and 10 characters");
+    assert(syntax_error("inc(mem(lea(\"abcdefghijk\")))") ==
+           "1:13 identifier has to have between 1 and 10 characters");
+    assert(syntax_error("data(a, num(1))\n\nmov(mem(num(0)),  lea( b ))") ==
+           "3:24 undeclared identifier b");
+    // Source large enough to be split into several chunks, with errors near its end.
+    std::string chunked;
+    constexpr size_t chunked_lines = 300000;
+    for (size_t i = 0; i < chunked_lines; ++i) {
+        chunked += i == 0 ? "data(x, num(1))\n" : "add(mem(num(1)), mem(lea(x)))\n";
+    }
+    Computer chunked_computer(2);
+    chunked_computer.boot(assembler.assemble(chunked));
+    assert(chunked_computer.at(1) == static_cast<ooasm::word_t>(chunked_lines - 1));
+    assert(syntax_error(chunked + "inc(mem(lea(y)))\n") ==
+           std::to_string(chunked_lines + 1) + ":13 undeclared identifier y");
+    assert(syntax_error(chunked + "inc(mem(num(1))\ninc(mem(num(1)))\n") ==
+           std::to_string(chunked_lines + 1) + ":16 expected ')'");
+
+    // Program built in arenas boots like the same program of language elements, also after
+    // builder whose instructions it took over is destroyed.
+    ooasm::ProgramBuilder builder;
+    builder.reserve(8);
+    builder.data("a", builder.num(4))
+           .data("b", builder.num(4))
+           .sub(builder.mem(builder.lea("a")), builder.mem(builder.lea("b")))
+           .onez(builder.mem(builder.num(2)))
+           .ones(builder.mem(builder.num(3)))
+           .add(builder.mem(builder.lea("b")), builder.num(-9));
+    {
+        ooasm::ProgramBuilder tail;
+        tail.ones(tail.mem(tail.num(4)))
+            .one(tail.mem(tail.lea("a")));
+        builder.append(std::move(tail));
+        assert(tail.size() == 0);
+    }
+    assert(builder.size() == 8);
+    auto built = builder.build();
+    assert(builder.size() == 0);
+    auto built_samples = samples();
+    auto const& [built_like, built_size] = built_samples.front();
+    Computer built_computer(built_size);
+    Computer built_like_computer(built_size);
+    for (int i = 0; i < 2; ++i) {
+        assert(outcome(built_computer, [&](Computer& c) { c.boot(built); }) ==
+               outcome(built_like_computer, [&](Computer& c) { c.boot(built_like); }));
+    }
+    // Builder is empty and can build another program after build, including one of nodes
+    // taking more than one block of arena.
+    constexpr size_t built_count = 5000;
+    builder.reserve(built_count);
+    std::vector<std::shared_ptr<ooasm::Instruction>> built_like_ins;
+    for (size_t i = 0; i < built_count; ++i) {
+        auto address = static_cast<ooasm::word_t>(i % 8);
+        builder.add(builder.mem(builder.num(address)), builder.num(address));
+        built_like_ins.push_back(add(mem(num(address)), num(address)));
+    }
+    auto built_large = builder.build();
+    ooasm::Program built_large_like(std::move(built_like_ins));
+    Computer built_large_computer(8);
+    built_large_computer.boot(built_large);
+    Computer built_large_like_computer(8);
+    built_large_like_computer.boot(built_large_like);
+    assert(state(built_large_computer) == state(built_large_like_computer));
+    assert(built_large_computer.at(7) == 7 * 625);
+    built_computer.boot(built);
+    assert(state(built_computer) == state(built_like_computer));
+
+    // Fleet running one program from different states, in some of which it faults.
+    ComputerFleet fleet(4, 4, 2);
+    std::vector<ooasm::word_t> pointers = {1, 9, 2, -1};
+    for (size_t i = 0; i < fleet.size(); ++i) {
+        fleet[i].boot(program({mov(mem(num(0)), num(pointers[i]))}));
+    }
+    auto fleet_errors = fleet.run(program({
+        add(mem(num(3)), mem(num(0))),
+        mov(mem(mem(num(0))), num(7)),
+        inc(mem(num(2)))
+    }));
+    assert(!fleet_errors[0] && fleet_errors[1] && !fleet_errors[2] && fleet_errors[3]);
+    assert(memory_dump(fleet[0]) == "1 7 1 1 ");
+    assert(memory_dump(fleet[1]) == "9 0 0 9 ");
+    assert(memory_dump(fleet[2]) == "2 0 8 2 ");
+    assert(memory_dump(fleet[3]) == "-1 0 0 -1 ");
+    try {
+        std::rethrow_exception(fleet_errors[1]);
+    } catch (computer::Memory::OutOfRangeMemoryAccessException const&) {
+    }
+    fleet_errors = fleet.boot(program({inc(mem(num(1)))}));
+    for (size_t i = 0; i < fleet.size(); ++i) {
+        assert(!fleet_errors[i] && memory_dump(fleet[i]) == "0 1 0 0 ");
+    }
+
+    // Forks and snapshots do not change when computer they were taken of runs on, nor does
+    // computer when its fork runs. Restore brings back variables and flags.
+    Computer original(6);
+    original.boot(program({
+        data("a", num(5)),
+        data("b", num(-1)),
+        add(mem(lea("b")), num(1)),
+        mov(mem(num(3)), num(9))
+    }));
+    auto taken = original.snapshot();
+    Computer forked = original.fork();
+    forked.run(unlinked({
+        mov(mem(lea("a")), num(7)),
+        sub(mem(num(4)), num(1))
+    }));
+    assert(state(forked) == "7 0 0 9 -1 0 ZF=0 SF=1");
+    assert(state(original) == "5 0 0 9 0 0 ZF=1 SF=0");
+    original.run(program({inc(mem(num(5)))}));
+    assert(state(Computer(taken)) == "5 0 0 9 0 0 ZF=1 SF=0");
+    assert(state(forked) == "7 0 0 9 -1 0 ZF=0 SF=1");
+    assert(state(forked.fork()) == state(forked));
+    original.boot(program({data("c", num(3)), ones(mem(num(1)))}));
+    original.restore(taken);
+    original.run(unlinked({
+        onez(mem(num(2))),
+        add(mem(lea("b")), mem(lea("a")))
+    }));
+    assert(state(original) == "5 5 1 9 0 0 ZF=0 SF=0");
+    forked.restore(original.snapshot());
+    forked.run(unlinked({ones(mem(num(4))), sub(mem(lea("a")), num(5))}));
+    assert(state(forked) == "0 5 1 9 0 0 ZF=1 SF=0");
+    assert(state(original) == "5 5 1 9 0 0 ZF=0 SF=0");
+
+    // Paged memory boots, faults and wipes like dense one.
+    for (auto const& [p, size] : samples()) {
+        Computer dense(size, computer::Backing::Dense);
+        Computer paged(size, computer::Backing::Paged);
+        Computer paged_bytecode(size, computer::Backing::Paged);
+        for (int i = 0; i < 2; ++i) {
+            std::string expected = outcome(dense, [&](Computer& c) { c.boot(p); });
+            assert(outcome(paged, [&](Computer& c) { c.boot(p); }) == expected);
+            assert(outcome(paged_bytecode, [&](Computer& c) {
+                c.boot(p, computer::Engine::Bytecode);
+            }) == expected);
+        }
+    }
+    constexpr ooasm::word_t pages_size = 3000;
+    Computer paged(pages_size, computer::Backing::Paged);
+    bool paged_fault = false;
+    try {
+        paged.boot(program({
+            mov(mem(num(0)), num(1)),
+            mov(mem(num(pages_size - 1)), num(2)),
+            mov(mem(num(pages_size)), num(3))
+        }));
+    } catch (computer::Memory::OutOfRangeMemoryAccessException const&) {
+        paged_fault = true;
+    }
+    assert(paged_fault && paged.at(0) == 1 && paged.at(pages_size - 1) == 2);
+    paged.boot(program({inc(mem(num(1)))}));
+    Computer zeros(pages_size);
+    zeros.boot(program({inc(mem(num(1)))}));
+    assert(paged.diff(zeros).empty());
+
+    // Dense memory reads snapshot back into its own words rather than mapping it.
+    Computer read_back(2, computer::Backing::Dense);
+    read_back.restore(paged.snapshot());
+    assert(read_back.memory_size() == pages_size && read_back.diff(zeros).empty());
+    read_back.run(program({mov(mem(num(0)), num(5))}));
+    assert(read_back.at(0) == 5 && paged.at(0) == 0);
+    assert(Computer(read_back.snapshot()).at(0) == 5);
+
+    // Snapshots of huge paged memory, of which they copy only pages written, the second one
+    // over pages of the first one, some of them back to zero.
+    constexpr ooasm::word_t far = ooasm::word_t(1) << 30;
+    Computer huge(uint64_t(1) << 31);
+    huge.boot(program({
+        data("x", num(2)),
+        mov(mem(num(far)), num(3)),
+        mov(mem(num(2 * far - 1)), mem(lea("x")))
+    }));
+    Computer huge_fork = huge.fork();
+    huge.run(unlinked({
+        mov(mem(num(far)), num(0)),
+        mov(mem(num(far + 1)), num(4)),
+        inc(mem(lea("x")))
+    }));
+    Computer huge_later = huge.fork();
+    assert(huge_fork.at(0) == 2 && huge_fork.at(far) == 3 && huge_fork.at(far + 1) == 0 &&
+           huge_fork.at(2 * far - 1) == 2);
+    assert(huge_later.at(0) == 3 && huge_later.at(far) == 0 && huge_later.at(far + 1) == 4 &&
+           huge_later.at(2 * far - 1) == 2);
+    assert(huge_later.getZF() == 0 && huge_later.getSF() == 0);
+
+    // Program without declarations, whose file ends with its ops.
+    ooasm::Bytecode incrementing(program({inc(mem(num(0))), inc(mem(num(1)))}));
+    ooasm::verify(incrementing, 2);
+    std::string file = saved(incrementing);
+    assert(!rejected(file));
+    std::string bad_version = file;
+    // Version follows 8 bytes of magic.
+    bad_version[8] = static_cast<char>(ooasm::BinaryFormat::VERSION + 1);
+    assert(rejected(bad_version));
+    assert(rejected(file.substr(0, file.size() - sizeof(ooasm::Bytecode::Op) / 2)));
+    std::string bad_flags = file;
+    size_t first_op = file.size() - 2 * sizeof(ooasm::Bytecode::Op);
+    bad_flags[first_op + offsetof(ooasm::Bytecode::Op, flags_dead)] = 2;
+    assert(rejected(bad_flags));
+    // Marks which verification does not prove, e.g. after file was edited.
+    ooasm::Bytecode unproven(program({inc(mem(num(2)))}));
+    unproven.mutable_code()[0].dst.verified = true;
+    unproven.mark_verified(2);
+    assert(rejected(saved(unproven)));
+    ooasm::Bytecode observed(program({inc(mem(num(0)))}));
+    ooasm::verify(observed, 1);
+    observed.mutable_code()[0].flags_dead = true;
+    observed.mark_verified(1);
+    assert(rejected(saved(observed)));
+
+    // Operand shared by programs declaring its variable at different addresses.
+    auto shared = mov(mem(num(0)), lea("b"));
+    auto ooasm_shared1 = program({data("a", num(1)), data("b", num(2)), shared});
+    auto ooasm_shared2 = program({data("b", num(2)), shared});
+    for (auto const& p : {ooasm_shared1, ooasm_shared2}) {
+        assert_like_tree(p, 2, [&](Computer& c) { c.boot(p, computer::Engine::Bytecode); });
+    }
+    Computer computer5(2);
+    computer5.boot(ooasm_shared1);
+    assert(memory_dump(computer5) == "1 2 ");
+    computer5.boot(ooasm_shared2);
+    assert(memory_dump(computer5) == "0 0 ");
+#if OOASM_INSTRUMENT
+    assert(computer5.instrumentation().dynamic_lookups() == 2);
+#endif
+
+    std::stringstream dump;
+    computer5.memory_dump_binary(dump);
+    dump << "abc";
+    assert(computer5.diff(dump) == std::vector<computer::Range>({{2, 3}}));
+
+    bool undeclared = false;
+    try {
+        program({inc(mem(lea("x")))});
+    } catch (std::exception const&) {
+        undeclared = true;
+    }
+    assert(undeclared);
 }
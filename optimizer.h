@@ -0,0 +1,206 @@
+#ifndef JNP1_6_OPTIMIZER_H
+#define JNP1_6_OPTIMIZER_H
+
+#include <unordered_set>
+#include <vector>
+#include "analysis.h"
+#include "bytecode.h"
+
+namespace ooasm {
+    // Peephole optimizer of bytecode booted on memory of given size. Rewrites preserve memory
+    // image and flags after every op which can be observed: at the end of program and where
+    // out of range access stops it. Operands are simplified using values known statically,
+    // adjacent arithmetic with immediates on the same cell is fused into single op and stores
+    // overwritten before being read are removed.
+    class Optimizer {
+    public:
+        using word_t = Memory::word_t;
+        using address_t = Memory::address_t;
+        using mem_size_t = Memory::mem_size_t;
+
+        Optimizer(Bytecode &_code, mem_size_t _size) : code(_code), size(_size) {}
+
+        // Optimizes bytecode, returning number of removed ops. Bytecode has to be verified again
+        // afterwards.
+        size_t run() {
+            size_t before = code.code().size();
+            simplify();
+            bool changed = true;
+            while (changed) {
+                changed = fuse();
+                changed = eliminate_dead_stores() || changed;
+            }
+            return before - code.code().size();
+        }
+
+    private:
+        Bytecode &code;
+        mem_size_t size;
+
+        // Whether operand refers to single cell at address known without running program.
+        static bool direct(const Bytecode::Operand &operand) {
+            return operand.depth == 1 && operand.mode == Bytecode::Mode::Imm;
+        }
+
+        static bool immediate(const Bytecode::Operand &operand) {
+            return operand.depth == 0 && operand.mode == Bytecode::Mode::Imm;
+        }
+
+        static bool arithmetic(const Bytecode::Op &op) {
+            return op.code == Bytecode::Opcode::Add || op.code == Bytecode::Opcode::Sub;
+        }
+
+        // Replaces operands whose values or addresses are known and reached by accesses proven
+        // to be in bounds, so that reading them has no observable effect, with immediates and
+        // direct references. Conditional ops whose flag is known become unconditional or go.
+        void simplify() {
+            StaticState state(code, size);
+            bool declared = code.declarations().size() <= size;
+            std::vector<Bytecode::Op> &ops = code.mutable_code();
+            std::vector<Bytecode::Op> result;
+            result.reserve(ops.size());
+            for (Bytecode::Op op : ops) {
+                if (declared) {
+                    simplify(op, state);
+                    if (op.code == Bytecode::Opcode::OneZ || op.code == Bytecode::Opcode::OneS) {
+                        StaticState::flag_t flag = op.code == Bytecode::Opcode::OneZ
+                                                   ? state.getZF() : state.getSF();
+                        if (flag.has_value() && !*flag) {
+                            continue;
+                        }
+                        if (flag.has_value()) {
+                            op.code = Bytecode::Opcode::One;
+                        }
+                    }
+                    bool dst_proven;
+                    bool src_proven;
+                    state.step(op, dst_proven, src_proven);
+                }
+                result.push_back(op);
+            }
+            ops = std::move(result);
+        }
+
+        void simplify(Bytecode::Op &op, const StaticState &state) const {
+            bool loads_dst = arithmetic(op);
+            if (op.code == Bytecode::Opcode::Mov || loads_dst) {
+                bool proven = true;
+                StaticState::value_t value = state.load(op.src, proven);
+                if (op.src.depth > 0 && proven && value.has_value()) {
+                    op.src = {*value, 0, Bytecode::Mode::Imm, false};
+                }
+            }
+            if (op.dst.depth > 1) {
+                bool proven = true;
+                std::optional<address_t> addr = state.address(op.dst, proven);
+                if (proven && addr.has_value()) {
+                    op.dst = {static_cast<word_t>(*addr), 1, Bytecode::Mode::Imm, false};
+                }
+            }
+        }
+
+        // Fuses adjacent add and sub of immediates to the same direct cell. Flags after fused
+        // op are those after the last one, and both fault exactly when the cell is out of range.
+        bool fuse() {
+            std::vector<Bytecode::Op> &ops = code.mutable_code();
+            std::vector<Bytecode::Op> result;
+            result.reserve(ops.size());
+            for (const Bytecode::Op &op : ops) {
+                if (!result.empty() && fusible(result.back()) && fusible(op) &&
+                    result.back().dst.value == op.dst.value) {
+                    Bytecode::Op &last = result.back();
+                    auto sum = static_cast<address_t>(signed_value(last)) +
+                               static_cast<address_t>(signed_value(op));
+                    auto total = static_cast<word_t>(sum);
+                    bool negative = total < 0 && total != INT64_MIN;
+                    last.code = negative ? Bytecode::Opcode::Sub : Bytecode::Opcode::Add;
+                    last.src.value = negative ? -total : total;
+                    continue;
+                }
+                result.push_back(op);
+            }
+            bool changed = result.size() != ops.size();
+            ops = std::move(result);
+            return changed;
+        }
+
+        static bool fusible(const Bytecode::Op &op) {
+            return arithmetic(op) && direct(op.dst) && immediate(op.src);
+        }
+
+        // Immediate added to cell by op, with wraparound.
+        static word_t signed_value(const Bytecode::Op &op) {
+            auto value = static_cast<address_t>(op.src.value);
+            return static_cast<word_t>(op.code == Bytecode::Opcode::Sub ? 0 - value : value);
+        }
+
+        // Removes mov and one to direct cells which are overwritten before being read. Ops
+        // which may fault expose memory as it is, so nothing before them is treated as dead.
+        bool eliminate_dead_stores() {
+            verify(code, size);
+            std::vector<Bytecode::Op> &ops = code.mutable_code();
+            std::vector<bool> removed(ops.size(), false);
+            std::unordered_set<address_t> dead;
+            bool changed = false;
+            for (size_t i = ops.size(); i-- > 0;) {
+                const Bytecode::Op &op = ops[i];
+                if (may_fault(op)) {
+                    dead.clear();
+                    continue;
+                }
+                bool store = op.code == Bytecode::Opcode::Mov || op.code == Bytecode::Opcode::One;
+                if (store && direct(op.dst) &&
+                    dead.count(static_cast<address_t>(op.dst.value)) > 0) {
+                    removed[i] = true;
+                    changed = true;
+                    continue;
+                }
+                if (store && direct(op.dst)) {
+                    dead.insert(static_cast<address_t>(op.dst.value));
+                }
+                if (!read(op.dst, arithmetic(op), dead) || !read(op.src, true, dead)) {
+                    dead.clear();
+                }
+            }
+            if (changed) {
+                std::vector<Bytecode::Op> result;
+                result.reserve(ops.size());
+                for (size_t i = 0; i < ops.size(); ++i) {
+                    if (!removed[i]) {
+                        result.push_back(ops[i]);
+                    }
+                }
+                ops = std::move(result);
+            }
+            return changed;
+        }
+
+        static bool may_fault(const Bytecode::Op &op) {
+            return (op.dst.depth > 0 && !op.dst.verified) ||
+                   (op.src.depth > 0 && !op.src.verified);
+        }
+
+        // Removes cell read through operand (whose value is <loaded> or which is only written)
+        // from dead ones. Returns false when it reads cells at addresses not known statically.
+        static bool read(const Bytecode::Operand &operand, bool loaded,
+                         std::unordered_set<address_t> &dead) {
+            if (operand.depth == 0) {
+                return true;
+            }
+            if (!direct(operand)) {
+                return operand.depth == 1 && !loaded;
+            }
+            if (loaded) {
+                dead.erase(static_cast<address_t>(operand.value));
+            }
+            return true;
+        }
+    };
+
+    // Optimizes bytecode for memory of given size, returning number of removed ops.
+    inline size_t optimize(Bytecode &code, Memory::mem_size_t size) {
+        return Optimizer(code, size).run();
+    }
+}
+
+#endif //JNP1_6_OPTIMIZER_H
@@ -0,0 +1,289 @@
+#ifndef JNP1_6_PARALLEL_H
+#define JNP1_6_PARALLEL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "analysis.h"
+#include "bytecode.h"
+#include "thread_pool.h"
+
+namespace computer {
+    using ooasm::Bytecode;
+
+    // Bytecode split for running on many cores, for memory of given size. Ops whose every
+    // access is proven to be in bounds touch cells known statically, so runs of them are split
+    // into chains of ops which touch common cells or pass flags to each other, and chains run
+    // concurrently, each in order. Ops which may fault or whose addresses depend on values not
+    // known statically are barriers: everything before them completes first and they run
+    // alone, so memory seen after fault and the final memory are those of sequential boot.
+    class ParallelProgram {
+    public:
+        using word_t = Memory::word_t;
+        using address_t = Memory::address_t;
+        using mem_size_t = Memory::mem_size_t;
+
+        // Ops [begin, end) of bytecode. Sequential segment is interpreted, parallel one runs
+        // its chains concurrently: ops of chain i are order[chains[i]] .. order[chains[i + 1]].
+        struct Segment {
+            size_t begin;
+            size_t end;
+            bool parallel;
+            std::vector<size_t> order;
+            std::vector<size_t> chains;
+            // Chain with the last arithmetic op of segment, whose flags segment leaves.
+            std::optional<size_t> flags_chain;
+        };
+
+        // Flags passed along chain.
+        struct Flags {
+            bool ZF;
+            bool SF;
+        };
+
+        // Parallel segments shorter than this run sequentially, as splitting them would cost
+        // more than it saves.
+        constexpr static size_t MIN_PARALLEL_OPS = 4096;
+
+        ParallelProgram(Bytecode _code, mem_size_t _size) : code(std::move(_code)), _size(_size) {
+            ooasm::verify(code, _size);
+            split();
+        }
+
+        // Whole program, verified for memory of size it was split for.
+        [[nodiscard]] const Bytecode &bytecode() const {
+            return code;
+        }
+
+        [[nodiscard]] bool split_for(mem_size_t size) const {
+            return size == _size;
+        }
+
+        [[nodiscard]] const std::vector<Segment> &segments() const {
+            return parts;
+        }
+
+        // Runs parallel segment on memory words in state sequential execution reaches before it,
+        // updating flags as it would.
+        void run(const Segment &segment, word_t *words, Flags &flags, ThreadPool &pool) const {
+            size_t count = segment.chains.size() - 1;
+            Flags start = flags;
+            // Consecutive chains are batched into tasks of similar numbers of ops.
+            size_t ops = segment.end - segment.begin;
+            size_t target = std::max<size_t>(1, ops / (pool.size() * 8));
+            std::vector<size_t> batches = {0};
+            for (size_t chain = 0; chain < count; ++chain) {
+                if (segment.chains[chain + 1] - segment.chains[batches.back()] >= target) {
+                    batches.push_back(chain + 1);
+                }
+            }
+            if (batches.back() != count) {
+                batches.push_back(count);
+            }
+            pool.parallel_for(batches.size() - 1, 1, [&](size_t batch) {
+                for (size_t chain = batches[batch]; chain < batches[batch + 1]; ++chain) {
+                    Flags local = start;
+                    run_chain(segment, chain, words, local);
+                    if (segment.flags_chain == chain) {
+                        flags = local;
+                    }
+                }
+            });
+        }
+
+    private:
+        Bytecode code;
+        mem_size_t _size;
+        std::vector<Segment> parts;
+
+        // Whether op touches only cells at addresses known statically and in bounds.
+        static bool independent(const Bytecode::Op &op) {
+            auto known = [](const Bytecode::Operand &operand) {
+                return operand.mode == Bytecode::Mode::Imm &&
+                       (operand.depth == 0 || operand.verified);
+            };
+            return known(op.dst) && known(op.src);
+        }
+
+        // Appends cells which operand touches, from its base to the accessed one.
+        static void cells_of(const Bytecode::Operand &operand, const ooasm::StaticState &state,
+                             std::vector<address_t> &cells) {
+            if (operand.depth == 0) {
+                return;
+            }
+            auto addr = static_cast<address_t>(operand.value);
+            cells.push_back(addr);
+            for (Bytecode::depth_t i = 1; i < operand.depth; ++i) {
+                addr = static_cast<address_t>(*state.get(addr));
+                cells.push_back(addr);
+            }
+        }
+
+        void split() {
+            ooasm::Span<Bytecode::Op> ops = code.code();
+            ooasm::StaticState state(code, _size);
+            bool declared = code.declarations().size() <= _size;
+            std::vector<address_t> cells;
+            std::vector<size_t> offsets = {0};
+            size_t begin = 0;
+            for (size_t i = 0; i < ops.size(); ++i) {
+                const Bytecode::Op &op = ops[i];
+                if (declared && independent(op)) {
+                    cells_of(op.dst, state, cells);
+                    cells_of(op.src, state, cells);
+                    offsets.push_back(cells.size());
+                } else {
+                    add_parallel(begin, i, cells, offsets);
+                    add_sequential(i, i + 1);
+                    begin = i + 1;
+                    cells.clear();
+                    offsets = {0};
+                }
+                if (declared) {
+                    bool dst_proven;
+                    bool src_proven;
+                    state.step(op, dst_proven, src_proven);
+                }
+            }
+            add_parallel(begin, ops.size(), cells, offsets);
+        }
+
+        void add_sequential(size_t begin, size_t end) {
+            if (!parts.empty() && !parts.back().parallel && parts.back().end == begin) {
+                parts.back().end = end;
+            } else if (begin < end) {
+                parts.push_back({begin, end, false, {}, {}, std::nullopt});
+            }
+        }
+
+        // Adds ops [begin, end) touching cells[offsets[i - begin]] .. cells[offsets[i - begin
+        // + 1]], split into chains with union-find.
+        void add_parallel(size_t begin, size_t end, const std::vector<address_t> &cells,
+                          const std::vector<size_t> &offsets) {
+            if (end - begin < MIN_PARALLEL_OPS) {
+                add_sequential(begin, end);
+                return;
+            }
+            ooasm::Span<Bytecode::Op> ops = code.code();
+            std::vector<size_t> parent(end - begin);
+            std::iota(parent.begin(), parent.end(), 0);
+            auto find = [&parent](size_t i) {
+                while (parent[i] != i) {
+                    parent[i] = parent[parent[i]];
+                    i = parent[i];
+                }
+                return i;
+            };
+            auto unite = [&](size_t a, size_t b) {
+                parent[find(a)] = find(b);
+            };
+            std::unordered_map<address_t, size_t> last_toucher;
+            std::optional<size_t> last_arithmetic;
+            for (size_t i = 0; i < end - begin; ++i) {
+                for (size_t c = offsets[i]; c < offsets[i + 1]; ++c) {
+                    auto [it, inserted] = last_toucher.try_emplace(cells[c], i);
+                    if (!inserted) {
+                        unite(i, it->second);
+                        it->second = i;
+                    }
+                }
+                Bytecode::Opcode opcode = ops[begin + i].code;
+                if (opcode == Bytecode::Opcode::Add || opcode == Bytecode::Opcode::Sub) {
+                    last_arithmetic = i;
+                } else if ((opcode == Bytecode::Opcode::OneZ ||
+                            opcode == Bytecode::Opcode::OneS) && last_arithmetic) {
+                    unite(i, *last_arithmetic);
+                }
+            }
+
+            // Chains numbered in order of their first ops, ops kept in program order.
+            Segment segment{begin, end, true, {}, {}, std::nullopt};
+            std::vector<size_t> chain_of(end - begin, SIZE_MAX);
+            std::vector<size_t> sizes;
+            for (size_t i = 0; i < end - begin; ++i) {
+                size_t root = find(i);
+                if (chain_of[root] == SIZE_MAX) {
+                    chain_of[root] = sizes.size();
+                    sizes.push_back(0);
+                }
+                sizes[chain_of[root]]++;
+            }
+            if (sizes.size() < 2) {
+                add_sequential(begin, end);
+                return;
+            }
+            segment.chains.resize(sizes.size() + 1, 0);
+            std::partial_sum(sizes.begin(), sizes.end(), segment.chains.begin() + 1);
+            std::vector<size_t> next(segment.chains.begin(), segment.chains.end() - 1);
+            segment.order.resize(end - begin);
+            for (size_t i = 0; i < end - begin; ++i) {
+                segment.order[next[chain_of[find(i)]]++] = begin + i;
+            }
+            if (last_arithmetic) {
+                segment.flags_chain = chain_of[find(*last_arithmetic)];
+            }
+            parts.push_back(std::move(segment));
+        }
+
+        void run_chain(const Segment &segment, size_t chain, word_t *words, Flags &flags) const {
+            ooasm::Span<Bytecode::Op> ops = code.code();
+            for (size_t k = segment.chains[chain]; k < segment.chains[chain + 1]; ++k) {
+                const Bytecode::Op &op = ops[segment.order[k]];
+                switch (op.code) {
+                    case Bytecode::Opcode::Mov:
+                        words[address(op.dst, words)] = load(op.src, words);
+                        break;
+                    case Bytecode::Opcode::Add:
+                    case Bytecode::Opcode::Sub: {
+                        address_t addr = address(op.dst, words);
+                        auto a1 = static_cast<address_t>(words[addr]);
+                        auto a2 = static_cast<address_t>(load(op.src, words));
+                        auto res = static_cast<word_t>(op.code == Bytecode::Opcode::Add
+                                                       ? a1 + a2 : a1 - a2);
+                        if (!op.flags_dead) {
+                            flags = {res == 0, res < 0};
+                        }
+                        words[addr] = res;
+                        break;
+                    }
+                    case Bytecode::Opcode::One:
+                        words[address(op.dst, words)] = 1;
+                        break;
+                    case Bytecode::Opcode::OneZ:
+                        if (flags.ZF) {
+                            words[address(op.dst, words)] = 1;
+                        }
+                        break;
+                    case Bytecode::Opcode::OneS:
+                        if (flags.SF) {
+                            words[address(op.dst, words)] = 1;
+                        }
+                        break;
+                }
+            }
+        }
+
+        static address_t address(const Bytecode::Operand &operand, const word_t *words) {
+            auto addr = static_cast<address_t>(operand.value);
+            for (Bytecode::depth_t i = 1; i < operand.depth; ++i) {
+                addr = static_cast<address_t>(words[addr]);
+            }
+            return addr;
+        }
+
+        static word_t load(const Bytecode::Operand &operand, const word_t *words) {
+            if (operand.depth == 0) {
+                return operand.value;
+            }
+            return words[address(operand, words)];
+        }
+    };
+}
+
+using computer::ParallelProgram;
+
+#endif //JNP1_6_PARALLEL_H
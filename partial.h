@@ -0,0 +1,181 @@
+#ifndef JNP1_6_PARTIAL_H
+#define JNP1_6_PARTIAL_H
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "analysis.h"
+#include "bytecode.h"
+
+namespace ooasm {
+    // Bytecode partially evaluated for memory of given size. Program has no input except flags
+    // left by previous boot, so its longest prefix whose every value, address and flag is known
+    // statically is run once here. Its effect is kept as image of memory cells and flags, and
+    // boot only copies image and runs the residual rest of program.
+    class PartialProgram {
+    public:
+        using word_t = Memory::word_t;
+        using address_t = Memory::address_t;
+        using mem_size_t = Memory::mem_size_t;
+        using flag_t = std::optional<bool>;
+
+        // Consecutive cells of image starting at <begin>, whose words are in words() at
+        // <offset>.
+        struct Run {
+            address_t begin;
+            size_t length;
+            size_t offset;
+        };
+
+        PartialProgram(Bytecode _code, mem_size_t _size)
+                : code(std::move(_code)), _size(_size) {
+            evaluate();
+        }
+
+        // Whole program, which computers of other memory size boot instead.
+        [[nodiscard]] const Bytecode &bytecode() const {
+            return code;
+        }
+
+        [[nodiscard]] bool evaluated_for(mem_size_t size) const {
+            return size == _size;
+        }
+
+        // Program without evaluated prefix, keeping declarations of variables. It has to run
+        // on memory holding image, never booted on its own.
+        [[nodiscard]] const Bytecode &residual() const {
+            return rest;
+        }
+
+        // Whether operands of residual marked as verified are proven for memory holding image.
+        [[nodiscard]] bool residual_verified() const {
+            return verified;
+        }
+
+        [[nodiscard]] const std::vector<Run> &runs() const {
+            return image_runs;
+        }
+
+        [[nodiscard]] const std::vector<word_t> &words() const {
+            return image_words;
+        }
+
+        // Flags after evaluated prefix, unknown when it did not set them.
+        [[nodiscard]] flag_t getZF() const {
+            return ZF;
+        }
+
+        [[nodiscard]] flag_t getSF() const {
+            return SF;
+        }
+
+        // Number of ops folded into image.
+        [[nodiscard]] size_t evaluated() const {
+            return code.code().size() - rest.code().size();
+        }
+
+    private:
+        Bytecode code;
+        mem_size_t _size;
+        Bytecode rest;
+        bool verified = false;
+        std::vector<Run> image_runs;
+        std::vector<word_t> image_words;
+        flag_t ZF, SF;
+
+        void evaluate() {
+            StaticState state(code, _size);
+            Span<Bytecode::Op> ops = code.code();
+            bool declared = code.declarations().size() <= _size;
+            size_t prefix = 0;
+            while (declared && prefix < ops.size() && known(ops[prefix], state)) {
+                bool dst_proven;
+                bool src_proven;
+                state.step(ops[prefix], dst_proven, src_proven);
+                ++prefix;
+            }
+            if (declared) {
+                make_image(state);
+                ZF = state.getZF();
+                SF = state.getSF();
+            }
+
+            for (const Bytecode::Decl &decl : code.declarations()) {
+                rest.declare(code.name(decl.name), decl.value);
+            }
+            for (size_t i = prefix; i < ops.size(); ++i) {
+                rest.emit(ops[i].code, reindex(ops[i].dst), reindex(ops[i].src));
+            }
+            // Residual is verified from state after prefix, as verify() does from boot state.
+            if (declared) {
+                for (Bytecode::Op &op : rest.mutable_code()) {
+                    bool dst_proven;
+                    bool src_proven;
+                    state.step(op, dst_proven, src_proven);
+                    op.dst.verified = dst_proven;
+                    op.src.verified = src_proven;
+                }
+                mark_dead_flags(rest);
+                verified = true;
+            }
+        }
+
+        // Operand with identifier index of residual instead of whole program.
+        Bytecode::Operand reindex(Bytecode::Operand operand) {
+            if (operand.mode == Bytecode::Mode::Var) {
+                operand.value = rest.intern(code.name(operand.value));
+            }
+            return operand;
+        }
+
+        // Whether op reads only known values and writes known cells, all within memory.
+        static bool known(const Bytecode::Op &op, const StaticState &state) {
+            bool proven = true;
+            switch (op.code) {
+                case Bytecode::Opcode::Mov: {
+                    bool value = state.load(op.src, proven).has_value();
+                    return value && state.address(op.dst, proven).has_value() && proven;
+                }
+                case Bytecode::Opcode::Add:
+                case Bytecode::Opcode::Sub: {
+                    bool values = state.load(op.dst, proven).has_value() &&
+                                  state.load(op.src, proven).has_value();
+                    return values && proven;
+                }
+                case Bytecode::Opcode::One:
+                    return state.address(op.dst, proven).has_value() && proven;
+                case Bytecode::Opcode::OneZ:
+                case Bytecode::Opcode::OneS: {
+                    StaticState::flag_t flag = op.code == Bytecode::Opcode::OneZ
+                                               ? state.getZF() : state.getSF();
+                    if (!flag.has_value()) {
+                        return false;
+                    }
+                    return !*flag || (state.address(op.dst, proven).has_value() && proven);
+                }
+            }
+            return false;
+        }
+
+        void make_image(const StaticState &state) {
+            std::vector<std::pair<address_t, word_t>> cells;
+            cells.reserve(state.touched().size());
+            for (const auto &[address, value] : state.touched()) {
+                cells.emplace_back(address, *value);
+            }
+            std::sort(cells.begin(), cells.end());
+            image_words.reserve(cells.size());
+            for (const auto &[address, value] : cells) {
+                if (image_runs.empty() ||
+                    image_runs.back().begin + image_runs.back().length != address) {
+                    image_runs.push_back({address, 0, image_words.size()});
+                }
+                image_runs.back().length++;
+                image_words.push_back(value);
+            }
+        }
+    };
+}
+
+#endif //JNP1_6_PARTIAL_H
@@ -0,0 +1,213 @@
+#ifndef JNP1_6_SCHEDULER_H
+#define JNP1_6_SCHEDULER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include "boot_task.h"
+#include "computer.h"
+#include "thread_pool.h"
+
+namespace computer {
+    // Runs boots of many computers, of any word width, on fixed pool of threads. Boots run in
+    // slices of instructions and share threads by stride scheduling: every boot has virtual
+    // time, which each of its slices advances inversely to its priority, and the boot furthest
+    // behind runs next. A boot with priority twice as high gets twice as many slices, and a
+    // short one finishes after a few slices whatever runs besides it.
+    class Scheduler {
+        struct State;
+
+    public:
+        using priority_t = uint32_t;
+
+        enum class Status {
+            Pending, Done, Failed, Cancelled
+        };
+
+        // Handle of submitted boot, which can be waited for from any thread.
+        class Job {
+        public:
+            [[nodiscard]] Status status() const {
+                std::lock_guard<std::mutex> guard(state->lock);
+                return state->status;
+            }
+
+            // Waits until boot finishes. Returns whether it ran to the end, as opposed to being
+            // cancelled, and rethrows exception which stopped it.
+            bool wait() const {
+                std::unique_lock<std::mutex> guard(state->lock);
+                state->finished.wait(guard, [this] { return state->status != Status::Pending; });
+                if (state->error) {
+                    std::rethrow_exception(state->error);
+                }
+                return state->status == Status::Done;
+            }
+
+        private:
+            friend class Scheduler;
+
+            explicit Job(std::shared_ptr<State> _state) : state(std::move(_state)) {}
+
+            std::shared_ptr<State> state;
+        };
+
+        // Boots submitted with computers run slices of <fuel> instructions.
+        explicit Scheduler(size_t fuel = DEFAULT_FUEL,
+                           size_t threads = std::thread::hardware_concurrency())
+                : _fuel(std::max<size_t>(fuel, 1)), pool(threads) {}
+
+        Scheduler(const Scheduler &) = delete;
+
+        Scheduler &operator=(const Scheduler &) = delete;
+
+        // Cancels boots which have not finished yet and waits for slices being run.
+        ~Scheduler() {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+            while (!ready.empty()) {
+                std::shared_ptr<State> state = std::move(ready.begin()->second);
+                ready.erase(ready.begin());
+                state->queued = false;
+                finish(*state, Status::Cancelled, nullptr);
+            }
+        }
+
+        // Schedules boot, which starts behind none of boots already scheduled. Priority of 0
+        // counts as 1.
+        Job submit(BootTask task, priority_t priority = 1) {
+            auto state = std::make_shared<State>();
+            state->task = std::move(task);
+            state->stride = std::max<uint64_t>(STRIDE / std::max<priority_t>(priority, 1), 1);
+            std::lock_guard<std::mutex> guard(lock);
+            state->time = virtual_time;
+            enqueue(state);
+            return Job(state);
+        }
+
+        // Schedules boot of bytecode on computer, see BasicComputer::boot_async for what has
+        // to be kept alive until it finishes.
+        template <typename Word>
+        Job submit(BasicComputer<Word> &computer, const Bytecode &code, priority_t priority = 1) {
+            return submit(computer.boot_async(code, _fuel), priority);
+        }
+
+        // Boot that has not started yet, or is between slices, is cancelled at once, one that
+        // runs a slice is cancelled once the slice ends. Computer is left in state its last
+        // slice left. Returns whether boot was not finished yet.
+        bool cancel(const Job &job) {
+            std::lock_guard<std::mutex> guard(lock);
+            State &state = *job.state;
+            if (state.queued) {
+                ready.erase({state.time, state.sequence});
+                state.queued = false;
+                finish(state, Status::Cancelled, nullptr);
+                return true;
+            }
+            if (state.running) {
+                state.cancelled = true;
+                return true;
+            }
+            return false;
+        }
+
+        [[nodiscard]] size_t fuel() const {
+            return _fuel;
+        }
+
+        [[nodiscard]] size_t threads() const {
+            return pool.size();
+        }
+
+    private:
+        constexpr static size_t DEFAULT_FUEL = 1 << 14;
+        constexpr static uint64_t STRIDE = 1 << 20;
+
+        // Fields other than those under <lock> are guarded by lock of scheduler.
+        struct State {
+            BootTask task;
+            uint64_t stride = 0;
+            uint64_t time = 0;
+            uint64_t sequence = 0;
+            bool queued = false;
+            bool running = false;
+            bool cancelled = false;
+
+            mutable std::mutex lock;
+            std::condition_variable finished;
+            Status status = Status::Pending;
+            std::exception_ptr error;
+        };
+
+        // Boots waiting for slice, by virtual time and then order of scheduling.
+        using key_t = std::pair<uint64_t, uint64_t>;
+
+        // Every boot put in queue posts one task to pool, which runs slice of whichever boot is
+        // first in queue by then. Cancelled boots leave tasks which find nothing to run.
+        void enqueue(const std::shared_ptr<State> &state) {
+            state->sequence = next_sequence++;
+            state->queued = true;
+            ready.emplace(key_t(state->time, state->sequence), state);
+            pool.submit([this] { run_slice(); });
+        }
+
+        void run_slice() {
+            std::shared_ptr<State> state;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (ready.empty()) {
+                    return;
+                }
+                virtual_time = ready.begin()->first.first;
+                state = std::move(ready.begin()->second);
+                ready.erase(ready.begin());
+                state->queued = false;
+                state->running = true;
+            }
+            bool done;
+            std::exception_ptr error;
+            try {
+                done = state->task.resume();
+            } catch (...) {
+                done = true;
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            state->running = false;
+            if (done) {
+                finish(*state, error ? Status::Failed : Status::Done, error);
+            } else if (state->cancelled || stopping) {
+                finish(*state, Status::Cancelled, nullptr);
+            } else {
+                state->time += state->stride;
+                enqueue(state);
+            }
+        }
+
+        // Releases coroutine of boot and wakes those waiting for it.
+        static void finish(State &state, Status status, std::exception_ptr error) {
+            state.task = BootTask();
+            std::lock_guard<std::mutex> guard(state.lock);
+            state.status = status;
+            state.error = std::move(error);
+            state.finished.notify_all();
+        }
+
+        size_t _fuel;
+        std::mutex lock;
+        std::map<key_t, std::shared_ptr<State>> ready;
+        uint64_t virtual_time = 0;
+        uint64_t next_sequence = 0;
+        bool stopping = false;
+        // Destroyed first, so that its threads finish with slices while queue still exists.
+        ThreadPool pool;
+    };
+}
+
+using computer::Scheduler;
+
+#endif //JNP1_6_SCHEDULER_H
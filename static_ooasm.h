@@ -0,0 +1,369 @@
+#ifndef JNP1_6_STATIC_OOASM_H
+#define JNP1_6_STATIC_OOASM_H
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <tuple>
+#include <type_traits>
+#include "ooasm.h"
+
+// Compile-time counterpart of ooasm language. Language elements are plain values whose types
+// encode program structure, so program known at build time involves no heap nodes and booting it
+// is straight-line code the optimizer can fully inline. Everything is constexpr, so programs can
+// be run and checked with static_assert; errors are then reported at compile time.
+namespace ooasm::ct {
+    using word_t = Memory::word_t;
+    using address_t = Memory::address_t;
+
+    constexpr bool same_id(const char *a, const char *b) {
+        while (*a != '\0' && *a == *b) {
+            ++a;
+            ++b;
+        }
+        return *a == *b;
+    }
+
+    constexpr const char *checked_id(const char *id) {
+        size_t len = 0;
+        while (id != nullptr && id[len] != '\0') {
+            ++len;
+        }
+        if (id == nullptr || len < 1 || len > 10) {
+            // Raises the same exception as ooasm::ID, and is not a constant expression.
+            static_cast<void>(ID(id));
+        }
+        return id;
+    }
+
+    struct Num {
+        word_t value;
+    };
+
+    struct Lea {
+        const char *id;
+        address_t slot;
+    };
+
+    template <typename Addr>
+    struct Mem {
+        Addr addr;
+    };
+
+    struct Data {
+        const char *id;
+        Num value;
+    };
+
+    template <typename Dst, typename Src>
+    struct Mov {
+        Dst dst;
+        Src src;
+    };
+
+    template <typename Dst, typename Src>
+    struct Add {
+        Dst arg1;
+        Src arg2;
+    };
+
+    template <typename Dst, typename Src>
+    struct Sub {
+        Dst arg1;
+        Src arg2;
+    };
+
+    template <typename Dst>
+    struct One {
+        Dst arg;
+    };
+
+    template <typename Dst>
+    struct OneZ {
+        Dst arg;
+    };
+
+    template <typename Dst>
+    struct OneS {
+        Dst arg;
+    };
+
+    // Identifiers of variables in order of declaration, used to bind lea elements.
+    template <size_t Count>
+    class Symbols {
+    public:
+        constexpr void declare(const char *id) {
+            ids[declared++] = id;
+        }
+
+        [[nodiscard]] constexpr address_t resolve(const char *id) const {
+            for (size_t i = 0; i < Count; ++i) {
+                if (same_id(ids[i], id)) {
+                    return i;
+                }
+            }
+            // Raises the same exception as linking of ooasm::Program.
+            return Linker().resolve(id);
+        }
+
+    private:
+        std::array<const char *, Count> ids{};
+        size_t declared = 0;
+    };
+
+    template <typename... Instructions>
+    class Program {
+    public:
+        constexpr explicit Program(Instructions... instructions) : ins(instructions...) {}
+
+        template <typename Function>
+        constexpr void for_each(Function function) const {
+            std::apply([&function](const Instructions &... i) { (function(i), ...); }, ins);
+        }
+
+        // Binds lea elements to addresses of variables, as ooasm::Program does on construction.
+        [[nodiscard]] constexpr Program linked() const {
+            Symbols<(std::is_same_v<Instructions, Data> + ... + 0)> symbols;
+            for_each([&symbols](const auto &i) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(i)>, Data>) {
+                    symbols.declare(i.id);
+                }
+            });
+            return std::apply([&symbols](const Instructions &... i) {
+                return Program(link(i, symbols)...);
+            }, ins);
+        }
+
+    private:
+        std::tuple<Instructions...> ins;
+
+        template <typename S>
+        static constexpr Num link(Num num, const S &) {
+            return num;
+        }
+
+        template <typename S>
+        static constexpr Lea link(Lea lea, const S &symbols) {
+            return {lea.id, symbols.resolve(lea.id)};
+        }
+
+        template <typename A, typename S>
+        static constexpr Mem<A> link(Mem<A> m, const S &symbols) {
+            return {link(m.addr, symbols)};
+        }
+
+        template <typename S>
+        static constexpr Data link(Data data, const S &) {
+            return data;
+        }
+
+        template <typename D, typename R, typename S>
+        static constexpr Mov<D, R> link(Mov<D, R> i, const S &symbols) {
+            return {link(i.dst, symbols), link(i.src, symbols)};
+        }
+
+        template <typename D, typename R, typename S>
+        static constexpr Add<D, R> link(Add<D, R> i, const S &symbols) {
+            return {link(i.arg1, symbols), link(i.arg2, symbols)};
+        }
+
+        template <typename D, typename R, typename S>
+        static constexpr Sub<D, R> link(Sub<D, R> i, const S &symbols) {
+            return {link(i.arg1, symbols), link(i.arg2, symbols)};
+        }
+
+        template <template <typename> typename Op, typename D, typename S>
+        static constexpr Op<D> link(Op<D> i, const S &symbols) {
+            return {link(i.arg, symbols)};
+        }
+    };
+
+    // Computer with memory of size known at compile time, counterpart of computer::Computer.
+    template <size_t Size>
+    class Computer {
+    public:
+        template <typename... Instructions>
+        constexpr void boot(const Program<Instructions...> &p) {
+            mem = {};
+            variables = 0;
+            p.for_each([this](const auto &i) { declare(i); });
+            p.for_each([this](const auto &i) { execute(i); });
+        }
+
+        [[nodiscard]] constexpr word_t at(address_t i) const {
+            check_address(i);
+            return mem[i];
+        }
+
+        [[nodiscard]] constexpr bool getZF() const {
+            return ZF;
+        }
+
+        [[nodiscard]] constexpr bool getSF() const {
+            return SF;
+        }
+
+        void memory_dump(std::ostream &os) const {
+            for (size_t i = 0; i < Size; ++i) {
+                os << static_cast<long long>(mem[i]) << " ";
+            }
+        }
+
+    private:
+        std::array<word_t, Size> mem{};
+        address_t variables = 0;
+        bool ZF = false;
+        bool SF = false;
+
+        static constexpr void check_address(address_t i) {
+            if (i >= Size) {
+                throw Memory::OutOfRangeMemoryAccessException();
+            }
+        }
+
+        constexpr void set(address_t i, word_t word) {
+            check_address(i);
+            mem[i] = word;
+        }
+
+        [[nodiscard]] constexpr word_t get(Num num) const {
+            return num.value;
+        }
+
+        [[nodiscard]] constexpr word_t get(Lea lea) const {
+            return lea.slot;
+        }
+
+        template <typename A>
+        [[nodiscard]] constexpr word_t get(Mem<A> m) const {
+            return at(get(m.addr));
+        }
+
+        template <typename A>
+        constexpr void set(Mem<A> m, word_t word) {
+            set(get(m.addr), word);
+        }
+
+        constexpr void declare(const Data &data) {
+            if (variables == Size) {
+                throw Memory::TooManyVariablesException();
+            }
+            set(variables++, data.value.value);
+        }
+
+        template <typename I>
+        constexpr void declare(const I &) {}
+
+        constexpr void execute(const Data &) {}
+
+        template <typename D, typename S>
+        constexpr void execute(const Mov<D, S> &i) {
+            set(i.dst, get(i.src));
+        }
+
+        template <typename D, typename S>
+        constexpr void execute(const Add<D, S> &i) {
+            arithmetic(i.arg1, static_cast<address_t>(get(i.arg1)) +
+                               static_cast<address_t>(get(i.arg2)));
+        }
+
+        template <typename D, typename S>
+        constexpr void execute(const Sub<D, S> &i) {
+            arithmetic(i.arg1, static_cast<address_t>(get(i.arg1)) -
+                               static_cast<address_t>(get(i.arg2)));
+        }
+
+        template <typename D>
+        constexpr void arithmetic(const D &dst, address_t result) {
+            auto res = static_cast<word_t>(result);
+            SF = res < 0;
+            ZF = res == 0;
+            set(dst, res);
+        }
+
+        template <typename D>
+        constexpr void execute(const One<D> &i) {
+            set(i.arg, 1);
+        }
+
+        template <typename D>
+        constexpr void execute(const OneZ<D> &i) {
+            if (ZF) {
+                set(i.arg, 1);
+            }
+        }
+
+        template <typename D>
+        constexpr void execute(const OneS<D> &i) {
+            if (SF) {
+                set(i.arg, 1);
+            }
+        }
+    };
+
+    // Language elements, mirroring those of ooasm.h.
+    constexpr Num num(word_t word) {
+        return {word};
+    }
+
+    constexpr Lea lea(const char *id) {
+        return {checked_id(id), 0};
+    }
+
+    template <typename Addr>
+    constexpr Mem<Addr> mem(Addr addr) {
+        return {addr};
+    }
+
+    constexpr Data data(const char *id, Num value) {
+        return {checked_id(id), value};
+    }
+
+    template <typename Dst, typename Src>
+    constexpr Mov<Mem<Dst>, Src> mov(Mem<Dst> dst, Src src) {
+        return {dst, src};
+    }
+
+    template <typename Dst, typename Src>
+    constexpr Add<Mem<Dst>, Src> add(Mem<Dst> arg1, Src arg2) {
+        return {arg1, arg2};
+    }
+
+    template <typename Dst, typename Src>
+    constexpr Sub<Mem<Dst>, Src> sub(Mem<Dst> arg1, Src arg2) {
+        return {arg1, arg2};
+    }
+
+    template <typename Dst>
+    constexpr Add<Mem<Dst>, Num> inc(Mem<Dst> arg) {
+        return {arg, num(1)};
+    }
+
+    template <typename Dst>
+    constexpr Sub<Mem<Dst>, Num> dec(Mem<Dst> arg) {
+        return {arg, num(1)};
+    }
+
+    template <typename Dst>
+    constexpr One<Mem<Dst>> one(Mem<Dst> arg) {
+        return {arg};
+    }
+
+    template <typename Dst>
+    constexpr OneZ<Mem<Dst>> onez(Mem<Dst> arg) {
+        return {arg};
+    }
+
+    template <typename Dst>
+    constexpr OneS<Mem<Dst>> ones(Mem<Dst> arg) {
+        return {arg};
+    }
+
+    // Creates program and links it, so unknown identifiers are reported at compile time.
+    template <typename... Instructions>
+    constexpr Program<Instructions...> program(Instructions... instructions) {
+        return Program<Instructions...>(instructions...).linked();
+    }
+}
+
+#endif //JNP1_6_STATIC_OOASM_H
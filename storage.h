@@ -0,0 +1,409 @@
+#ifndef JNP1_6_STORAGE_H
+#define JNP1_6_STORAGE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+#if defined(__linux__)
+#define OOASM_MAPPED_STORAGE 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define OOASM_MAPPED_STORAGE 0
+#endif
+
+namespace computer {
+    template <typename Word>
+    class BasicStorage;
+
+    // Immutable copy of memory words. Where memory file descriptors are available, words are
+    // kept in an anonymous file which storages map copy-on-write, so restoring image costs only
+    // pages touched afterwards. Elsewhere image is an array copied on restore.
+    template <typename Word>
+    class BasicImage {
+    public:
+        using word_t = Word;
+        using mem_size_t = uint64_t;
+
+        BasicImage(const word_t *words, mem_size_t size) : BasicImage(size) {
+#if OOASM_MAPPED_STORAGE
+            if (fd >= 0 && write_pages(words, 0, size, true)) {
+                return;
+            }
+            if (fd >= 0) {
+                close(fd);
+                fd = -1;
+            }
+#endif
+            copy = std::make_unique<word_t[]>(size);
+            std::copy_n(words, size, copy.get());
+        }
+
+        BasicImage(const BasicImage &) = delete;
+
+        BasicImage &operator=(const BasicImage &) = delete;
+
+        ~BasicImage() {
+#if OOASM_MAPPED_STORAGE
+            if (fd >= 0) {
+                close(fd);
+            }
+#endif
+        }
+
+        [[nodiscard]] mem_size_t size() const {
+            return _size;
+        }
+
+        [[nodiscard]] bool mappable() const {
+            return fd >= 0;
+        }
+
+        [[nodiscard]] int descriptor() const {
+            return fd;
+        }
+
+        [[nodiscard]] const word_t *words() const {
+            return copy.get();
+        }
+
+    private:
+        friend class BasicStorage<Word>;
+
+        // Image of zeros, which storage fills with words it knows to have changed. Image
+        // which is not mappable then is unusable.
+        explicit BasicImage(mem_size_t size) : _size(size) {
+#if OOASM_MAPPED_STORAGE
+            fd = memfd_create("ooasm-image", MFD_CLOEXEC);
+            if (fd >= 0 && ftruncate(fd, static_cast<off_t>(size * sizeof(word_t))) != 0) {
+                close(fd);
+                fd = -1;
+            }
+#endif
+        }
+
+        mem_size_t _size;
+        int fd = -1;
+        std::unique_ptr<word_t[]> copy;
+
+#if OOASM_MAPPED_STORAGE
+        // Writes pages of words [begin, end) at their offsets. Pages which are all zero are
+        // left as holes if <skip_zero>, which only holds where file has no data yet.
+        bool write_pages(const word_t *words, mem_size_t begin, mem_size_t end, bool skip_zero) {
+            const size_t page_words = sysconf(_SC_PAGESIZE) / sizeof(word_t);
+            for (; begin < end; begin += page_words) {
+                mem_size_t page_end = std::min<mem_size_t>(end, begin + page_words);
+                if (skip_zero && std::all_of(words + begin, words + page_end,
+                                             [](word_t w) { return w == 0; })) {
+                    continue;
+                }
+                const char *bytes = reinterpret_cast<const char *>(words + begin);
+                size_t length = (page_end - begin) * sizeof(word_t);
+                auto offset = static_cast<off_t>(begin * sizeof(word_t));
+                while (length > 0) {
+                    ssize_t written = pwrite(fd, bytes, length, offset);
+                    if (written <= 0) {
+                        return false;
+                    }
+                    bytes += written;
+                    length -= written;
+                    offset += written;
+                }
+            }
+            return true;
+        }
+
+        // Copies data of other image of the same size, skipping its holes.
+        bool copy_data(const BasicImage &other) {
+            auto end = static_cast<off_t>(_size * sizeof(word_t));
+            off_t from = 0;
+            while (from < end) {
+                from = lseek(other.fd, from, SEEK_DATA);
+                if (from < 0) {
+                    // No data after <from>.
+                    return true;
+                }
+                off_t hole = lseek(other.fd, from, SEEK_HOLE);
+                if (hole < 0) {
+                    return false;
+                }
+                off_t to = from;
+                while (from < hole) {
+                    ssize_t copied = copy_file_range(other.fd, &from, fd, &to,
+                                                     static_cast<size_t>(hole - from), 0);
+                    if (copied <= 0) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+#endif
+    };
+
+    using Image = BasicImage<int64_t>;
+
+    // How storage of memory is allocated. Dense storage is a heap array zeroed up front, which
+    // it stays, reading images back into it rather than mapping them. Paged storage is reserved
+    // address space whose pages are allocated and zeroed by the system on first touch, so
+    // memories of huge size cost only pages programs actually use.
+    enum class Backing {
+        Automatic, Dense, Paged
+    };
+
+    // Words backing Memory: zeroed heap array, anonymous mapping of pages allocated on first
+    // touch, or private copy-on-write mapping of an image.
+    template <typename Word>
+    class BasicStorage {
+    public:
+        using word_t = Word;
+        using mem_size_t = uint64_t;
+        using image_t = BasicImage<Word>;
+
+        // Automatic backing pages storages of at least this many words.
+        static constexpr mem_size_t paged_threshold = mem_size_t(1) << 18;
+
+        explicit BasicStorage(mem_size_t size, Backing backing = Backing::Automatic)
+                : _size(size), dense(backing == Backing::Dense) {
+            if (backing == Backing::Automatic) {
+                backing = size >= paged_threshold ? Backing::Paged : Backing::Dense;
+            }
+            if (backing == Backing::Paged && size > 0 && map_anonymous()) {
+                return;
+            }
+            array = std::make_unique<word_t[]>(size);
+            words = array.get();
+        }
+
+        BasicStorage(const BasicStorage &) = delete;
+
+        BasicStorage &operator=(const BasicStorage &) = delete;
+
+        ~BasicStorage() {
+            unmap();
+        }
+
+        [[nodiscard]] word_t *get() const {
+            return words;
+        }
+
+        word_t &operator[](mem_size_t i) const {
+            return words[i];
+        }
+
+        [[nodiscard]] mem_size_t size() const {
+            return _size;
+        }
+
+        [[nodiscard]] bool paged() const {
+            return mapping != nullptr;
+        }
+
+        void zero() {
+            if (mapping == nullptr) {
+                std::fill_n(words, _size, 0);
+                return;
+            }
+#if OOASM_MAPPED_STORAGE
+            // Fresh anonymous pages are zeroed lazily, when first touched.
+            if (mmap(mapping, mapping_length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) ==
+                MAP_FAILED) {
+                std::fill_n(words, _size, 0);
+                return;
+            }
+            base.reset();
+#endif
+        }
+
+        // Replaces words with those of image. Mapped image is shared until pages are written.
+        void load(std::shared_ptr<const image_t> image) {
+            if (!dense && map(image)) {
+                return;
+            }
+            unmap();
+            _size = image->size();
+            array = std::make_unique<word_t[]>(_size);
+            words = array.get();
+            if (image->mappable()) {
+                read(*image);
+            } else {
+                std::copy_n(image->words(), _size, words);
+            }
+        }
+
+        // Image of words, which storage which is not dense maps afterwards in place of its own
+        // pages, so that it shares them with storages loaded from image until either side
+        // writes them. Where the system tells which pages of mapping were written, only those
+        // are read, rather than every word of huge paged storage.
+        std::shared_ptr<const image_t> snapshot() {
+            std::shared_ptr<const image_t> image;
+#if OOASM_MAPPED_STORAGE
+            if (mapping != nullptr) {
+                image = copy_written();
+            }
+#endif
+            if (image == nullptr) {
+                image = std::make_shared<const image_t>(words, _size);
+            }
+            if (!dense) {
+                map(image);
+            }
+            return image;
+        }
+
+    private:
+        // Entries of page map read at once.
+        static constexpr size_t PAGEMAP_BATCH = 1 << 12;
+
+        mem_size_t _size;
+        // Storage was asked to be dense, so it is never mapped.
+        bool dense;
+        std::unique_ptr<word_t[]> array;
+        word_t *words = nullptr;
+        void *mapping = nullptr;
+        size_t mapping_length = 0;
+        // Image which mapping maps, whose pages it keeps until they are written, or null if
+        // mapping is anonymous.
+        std::shared_ptr<const image_t> base;
+
+        // Maps image in place of words, unless it is not mappable.
+        bool map(const std::shared_ptr<const image_t> &image) {
+#if OOASM_MAPPED_STORAGE
+            if (image->mappable() && image->size() > 0) {
+                size_t length = image->size() * sizeof(word_t);
+                void *region = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_NORESERVE, image->descriptor(), 0);
+                if (region != MAP_FAILED) {
+                    unmap();
+                    array.reset();
+                    _size = image->size();
+                    mapping = region;
+                    mapping_length = length;
+                    words = static_cast<word_t *>(region);
+                    base = image;
+                    return true;
+                }
+            }
+#else
+            static_cast<void>(image);
+#endif
+            return false;
+        }
+
+        bool map_anonymous() {
+#if OOASM_MAPPED_STORAGE
+            if (_size > SIZE_MAX / sizeof(word_t)) {
+                throw std::bad_alloc();
+            }
+            size_t length = _size * sizeof(word_t);
+            void *region = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (region == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            mapping = region;
+            mapping_length = length;
+            words = static_cast<word_t *>(region);
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        void unmap() {
+#if OOASM_MAPPED_STORAGE
+            if (mapping != nullptr) {
+                munmap(mapping, mapping_length);
+                mapping = nullptr;
+            }
+#endif
+            base.reset();
+        }
+
+#if OOASM_MAPPED_STORAGE
+        // Image of words of mapping, made of data of image it maps and of pages which page
+        // map of process shows to have been written since, or null if it cannot be read.
+        [[nodiscard]] std::shared_ptr<const image_t> copy_written() const {
+            int pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+            if (pagemap < 0) {
+                return nullptr;
+            }
+            std::shared_ptr<image_t> image(new image_t(_size));
+            bool copied = image->mappable() && (base == nullptr || image->copy_data(*base)) &&
+                          write_written(*image, pagemap);
+            close(pagemap);
+            return copied ? image : nullptr;
+        }
+
+        // Writes pages of mapping into image. Page of anonymous mapping which was never
+        // touched is neither present nor swapped out, and page of image which was not written
+        // is still page of its file.
+        bool write_written(image_t &image, int pagemap) const {
+            constexpr uint64_t present = uint64_t(1) << 63;
+            constexpr uint64_t swapped = uint64_t(1) << 62;
+            constexpr uint64_t file = uint64_t(1) << 61;
+            const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            const size_t page_words = page_size / sizeof(word_t);
+            const size_t first = reinterpret_cast<uintptr_t>(mapping) / page_size;
+            const size_t pages = (mapping_length + page_size - 1) / page_size;
+            std::vector<uint64_t> entries(std::min<size_t>(pages, PAGEMAP_BATCH));
+            for (size_t page = 0; page < pages; page += entries.size()) {
+                size_t count = std::min(entries.size(), pages - page);
+                auto *bytes = reinterpret_cast<char *>(entries.data());
+                size_t length = count * sizeof(uint64_t);
+                auto offset = static_cast<off_t>((first + page) * sizeof(uint64_t));
+                while (length > 0) {
+                    ssize_t got = pread(pagemap, bytes, length, offset);
+                    if (got <= 0) {
+                        return false;
+                    }
+                    bytes += got;
+                    length -= got;
+                    offset += got;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    uint64_t entry = entries[i];
+                    bool written = base == nullptr ? (entry & (present | swapped)) != 0
+                                                   : (entry & swapped) != 0 ||
+                                                     (entry & (present | file)) == present;
+                    mem_size_t begin = (page + i) * page_words;
+                    if (written && !image.write_pages(words, begin,
+                                                      std::min(_size, begin + page_words),
+                                                      base == nullptr)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+#endif
+
+        void read(const image_t &image) {
+#if OOASM_MAPPED_STORAGE
+            auto *bytes = reinterpret_cast<char *>(words);
+            size_t length = _size * sizeof(word_t);
+            off_t offset = 0;
+            while (length > 0) {
+                ssize_t count = pread(image.descriptor(), bytes, length, offset);
+                if (count <= 0) {
+                    break;
+                }
+                bytes += count;
+                length -= count;
+                offset += count;
+            }
+#else
+            static_cast<void>(image);
+#endif
+        }
+    };
+
+    using Storage = BasicStorage<int64_t>;
+}
+
+#endif //JNP1_6_STORAGE_H
@@ -0,0 +1,185 @@
+#ifndef JNP1_6_THREAD_POOL_H
+#define JNP1_6_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace computer {
+    // Pool of worker threads with work stealing: every worker takes tasks from the back of its
+    // own queue and, when it runs dry, steals from the front of queues of the others.
+    class ThreadPool {
+    public:
+        using task_t = std::function<void()>;
+
+        explicit ThreadPool(size_t threads = std::thread::hardware_concurrency()) {
+            threads = std::max<size_t>(threads, 1);
+            for (size_t i = 0; i < threads; ++i) {
+                queues.push_back(std::make_unique<Queue>());
+            }
+            for (size_t i = 0; i < threads; ++i) {
+                workers.emplace_back([this, i] { work(i); });
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> guard(idle_lock);
+                stopping = true;
+            }
+            idle.notify_all();
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+        }
+
+        [[nodiscard]] size_t size() const {
+            return workers.size();
+        }
+
+        void submit(task_t task) {
+            size_t target = next_queue++ % queues.size();
+            // Counted before it can be popped, as pop() uncounts it. Worker woken in between
+            // finds nothing to pop only until task is pushed.
+            {
+                std::lock_guard<std::mutex> guard(idle_lock);
+                pending++;
+            }
+            {
+                std::lock_guard<std::mutex> guard(queues[target]->lock);
+                queues[target]->tasks.push_back(std::move(task));
+            }
+            idle.notify_one();
+        }
+
+        // Calls <function> for every index in [0, count), in chunks of <grain> consecutive
+        // indices, and waits until all are done. Calling thread helps with pending tasks while
+        // waiting, so it is safe to call from inside a task. First exception is rethrown.
+        template <typename Function>
+        void parallel_for(size_t count, size_t grain, Function function) {
+            grain = std::max<size_t>(grain, 1);
+            Group group;
+            group.remaining = (count + grain - 1) / grain;
+            for (size_t begin = 0; begin < count; begin += grain) {
+                size_t end = std::min(count, begin + grain);
+                submit([&group, &function, begin, end] {
+                    try {
+                        for (size_t i = begin; i < end; ++i) {
+                            function(i);
+                        }
+                    } catch (...) {
+                        std::lock_guard<std::mutex> guard(group.lock);
+                        if (!group.error) {
+                            group.error = std::current_exception();
+                        }
+                    }
+                    std::lock_guard<std::mutex> guard(group.lock);
+                    if (--group.remaining == 0) {
+                        group.done.notify_all();
+                    }
+                });
+            }
+            wait(group);
+            if (group.error) {
+                std::rethrow_exception(group.error);
+            }
+        }
+
+        // Grain splitting <count> indices into a few chunks per worker.
+        [[nodiscard]] size_t default_grain(size_t count) const {
+            return std::max<size_t>(1, count / (size() * CHUNKS_PER_WORKER));
+        }
+
+    private:
+        constexpr static size_t CHUNKS_PER_WORKER = 8;
+
+        struct Queue {
+            std::mutex lock;
+            std::deque<task_t> tasks;
+        };
+
+        struct Group {
+            std::mutex lock;
+            std::condition_variable done;
+            size_t remaining = 0;
+            std::exception_ptr error;
+        };
+
+        bool pop(size_t self, task_t &task) {
+            for (size_t i = 0; i < queues.size(); ++i) {
+                Queue &queue = *queues[(self + i) % queues.size()];
+                std::lock_guard<std::mutex> guard(queue.lock);
+                if (queue.tasks.empty()) {
+                    continue;
+                }
+                if (i == 0) {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                } else {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                std::lock_guard<std::mutex> idle_guard(idle_lock);
+                pending--;
+                return true;
+            }
+            return false;
+        }
+
+        void work(size_t self) {
+            task_t task;
+            while (true) {
+                if (pop(self, task)) {
+                    task();
+                    continue;
+                }
+                std::unique_lock<std::mutex> guard(idle_lock);
+                idle.wait(guard, [this] { return stopping || pending > 0; });
+                if (stopping && pending == 0) {
+                    return;
+                }
+            }
+        }
+
+        void wait(Group &group) {
+            task_t task;
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> guard(group.lock);
+                    if (group.remaining == 0) {
+                        return;
+                    }
+                }
+                if (pop(next_queue % queues.size(), task)) {
+                    task();
+                    continue;
+                }
+                // Nothing left to steal, so the rest of group is being run by workers.
+                std::unique_lock<std::mutex> guard(group.lock);
+                group.done.wait(guard, [&group] { return group.remaining == 0; });
+                return;
+            }
+        }
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> next_queue{0};
+        std::mutex idle_lock;
+        std::condition_variable idle;
+        size_t pending = 0;
+        bool stopping = false;
+    };
+}
+
+#endif //JNP1_6_THREAD_POOL_H
@@ -0,0 +1,333 @@
+#ifndef JNP1_6_TRACE_H
+#define JNP1_6_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "computer_components.h"
+
+// Recording writes made by boots of computer and replaying them.
+namespace computer {
+    // Event of trace, 32 bytes. Tag packs index of op (of bytecode, so declarations do not
+    // count), kind of event and flags right after it.
+    struct TraceEvent {
+        enum class Kind : uint8_t {
+            // Memory wiped for new boot, of size kept in <address>.
+            Boot,
+            // Declaration of variable at <address>.
+            Declare,
+            // Write of op at <index> to <address>.
+            Write
+        };
+
+        uint64_t tag;
+        Memory::address_t address;
+        Memory::word_t old_value;
+        Memory::word_t new_value;
+
+        static TraceEvent make(Kind kind, uint64_t index, Memory::address_t address,
+                               Memory::word_t old_value, Memory::word_t new_value, bool ZF,
+                               bool SF) {
+            uint64_t tag = index << 8 | static_cast<uint64_t>(kind) << 2 |
+                           static_cast<uint64_t>(SF) << 1 | static_cast<uint64_t>(ZF);
+            return {tag, address, old_value, new_value};
+        }
+
+        [[nodiscard]] Kind kind() const {
+            return static_cast<Kind>(tag >> 2 & 0x3f);
+        }
+
+        [[nodiscard]] uint64_t index() const {
+            return tag >> 8;
+        }
+
+        [[nodiscard]] bool getZF() const {
+            return tag & 1;
+        }
+
+        [[nodiscard]] bool getSF() const {
+            return tag >> 1 & 1;
+        }
+    };
+
+    // Trace file: magic, version and size of event, then events in native byte order.
+    struct TraceHeader {
+        constexpr static char MAGIC[8] = {'O', 'O', 'A', 'S', 'M', 'T', '\r', '\n'};
+        constexpr static uint32_t VERSION = 1;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t event_size;
+    };
+
+    // Records events into lock-free ring read by background thread, which spills them to file.
+    // Interpreter never waits for file, only for the spilling thread when it falls a whole ring
+    // behind. Events have to be recorded by one thread at a time.
+    class TraceRecorder {
+    public:
+        explicit TraceRecorder(const std::string &path, size_t capacity = 1 << 16)
+                : file(path, std::ios::binary | std::ios::trunc),
+                  ring(round_up(capacity)), mask(ring.size() - 1) {
+            TraceHeader header{};
+            std::memcpy(header.magic, TraceHeader::MAGIC, sizeof(header.magic));
+            header.version = TraceHeader::VERSION;
+            header.event_size = sizeof(TraceEvent);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            if (!file) {
+                throw UnwritableFileException();
+            }
+            spiller = std::thread([this] { spill(); });
+        }
+
+        TraceRecorder(const TraceRecorder &) = delete;
+
+        TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+        // Spills remaining events and closes file.
+        ~TraceRecorder() {
+            stopping.store(true, std::memory_order_release);
+            spiller.join();
+        }
+
+        void boot(Memory::mem_size_t size, bool ZF, bool SF) {
+            push(TraceEvent::make(TraceEvent::Kind::Boot, 0, size, 0, 0, ZF, SF));
+        }
+
+        void declared(Memory::address_t address, Memory::word_t value, bool ZF, bool SF) {
+            push(TraceEvent::make(TraceEvent::Kind::Declare, 0, address, 0, value, ZF, SF));
+        }
+
+        void written(uint64_t index, Memory::address_t address, Memory::word_t old_value,
+                     Memory::word_t new_value, bool ZF, bool SF) {
+            push(TraceEvent::make(TraceEvent::Kind::Write, index, address, old_value, new_value,
+                                  ZF, SF));
+        }
+
+        // Waits until events recorded so far are in file.
+        void flush() {
+            size_t recorded = tail.load(std::memory_order_relaxed);
+            while (spilled.load(std::memory_order_acquire) < recorded) {
+                if (failed.load(std::memory_order_acquire)) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+            if (failed.load(std::memory_order_acquire)) {
+                throw UnwritableFileException();
+            }
+        }
+
+        // Number of events which had to wait for space in ring.
+        [[nodiscard]] uint64_t stalls() const {
+            return stall_count;
+        }
+
+        class UnwritableFileException : public std::exception {
+            [[nodiscard]] const char *what() const noexcept override {
+                return "Trace cannot be written!";
+            }
+        };
+
+    private:
+        static size_t round_up(size_t capacity) {
+            size_t size = 2;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            return size;
+        }
+
+        void push(const TraceEvent &event) {
+            size_t at = tail.load(std::memory_order_relaxed);
+            if (at - head.load(std::memory_order_acquire) == ring.size()) {
+                stall_count++;
+                while (at - head.load(std::memory_order_acquire) == ring.size()) {
+                    std::this_thread::yield();
+                }
+            }
+            ring[at & mask] = event;
+            tail.store(at + 1, std::memory_order_release);
+        }
+
+        // Body of spilling thread: writes contiguous parts of ring, flushing file whenever
+        // it catches up, and drains ring once recorder is destroyed.
+        void spill() {
+            bool unflushed = false;
+            while (true) {
+                size_t from = head.load(std::memory_order_relaxed);
+                size_t to = tail.load(std::memory_order_acquire);
+                if (from == to) {
+                    if (unflushed) {
+                        file.flush();
+                        unflushed = false;
+                        failed.store(!file, std::memory_order_release);
+                        spilled.store(to, std::memory_order_release);
+                    }
+                    if (stopping.load(std::memory_order_acquire) &&
+                        tail.load(std::memory_order_acquire) == to) {
+                        return;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    continue;
+                }
+                size_t end = std::min(to, from + ring.size() - (from & mask));
+                file.write(reinterpret_cast<const char *>(&ring[from & mask]),
+                           static_cast<std::streamsize>((end - from) * sizeof(TraceEvent)));
+                unflushed = true;
+                head.store(end, std::memory_order_release);
+            }
+        }
+
+        std::ofstream file;
+        std::vector<TraceEvent> ring;
+        size_t mask;
+        uint64_t stall_count = 0;
+        // Counters of events, increasing without wrapping, on separate cache lines.
+        alignas(64) std::atomic<size_t> tail{0};
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> spilled{0};
+        std::atomic<bool> stopping{false};
+        std::atomic<bool> failed{false};
+        std::thread spiller;
+    };
+
+    // Trace read from file, rebuilding memory of its boots before any op, either forward from
+    // the boot or backwards from memory in state the boot left it in.
+    class TraceReplay {
+    public:
+        using word_t = Memory::word_t;
+        using address_t = Memory::address_t;
+
+        // Flags at some point of traced boot.
+        struct Flags {
+            bool ZF;
+            bool SF;
+        };
+
+        explicit TraceReplay(const std::string &path) {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) {
+                throw InvalidTraceException();
+            }
+            auto length = static_cast<size_t>(file.tellg());
+            TraceHeader header{};
+            file.seekg(0);
+            file.read(reinterpret_cast<char *>(&header), sizeof(header));
+            bool valid = file &&
+                         std::memcmp(header.magic, TraceHeader::MAGIC, sizeof(header.magic)) == 0 &&
+                         header.version == TraceHeader::VERSION &&
+                         header.event_size == sizeof(TraceEvent) &&
+                         (length - sizeof(header)) % sizeof(TraceEvent) == 0;
+            if (!valid) {
+                throw InvalidTraceException();
+            }
+            events.resize((length - sizeof(header)) / sizeof(TraceEvent));
+            file.read(reinterpret_cast<char *>(events.data()),
+                      static_cast<std::streamsize>(events.size() * sizeof(TraceEvent)));
+            if (!file) {
+                throw InvalidTraceException();
+            }
+            for (size_t i = 0; i < events.size(); ++i) {
+                if (events[i].kind() == TraceEvent::Kind::Boot) {
+                    boot_starts.push_back(i);
+                } else if (events[i].kind() > TraceEvent::Kind::Write || boot_starts.empty()) {
+                    throw InvalidTraceException();
+                }
+            }
+            boot_starts.push_back(events.size());
+        }
+
+        [[nodiscard]] size_t boots() const {
+            return boot_starts.size() - 1;
+        }
+
+        [[nodiscard]] Memory::mem_size_t memory_size(size_t boot) const {
+            return events[boot_starts.at(boot)].address;
+        }
+
+        [[nodiscard]] const std::vector<TraceEvent> &all() const {
+            return events;
+        }
+
+        // Rebuilds memory of boot as it was before op at <index>, replaying boot from start.
+        // Trace keeps words widened to 64 bits, so memory has to be of the traced width.
+        template <typename Word>
+        Flags replay(BasicMemory<Word> &memory, size_t boot, uint64_t index) const {
+            check(memory.size(), boot);
+            memory.wipe();
+            Word *words = memory.data();
+            const TraceEvent &start = events[boot_starts[boot]];
+            Flags flags{start.getZF(), start.getSF()};
+            for (size_t i = boot_starts[boot] + 1; i < boot_starts[boot + 1]; ++i) {
+                const TraceEvent &event = events[i];
+                if (event.kind() == TraceEvent::Kind::Write && event.index() >= index) {
+                    break;
+                }
+                words[event.address] = static_cast<Word>(event.new_value);
+                flags = {event.getZF(), event.getSF()};
+            }
+            return flags;
+        }
+
+        // Rebuilds memory of boot as it was before op at <index>, undoing writes of ops at and
+        // after it on memory in state the boot left it in.
+        template <typename Word>
+        Flags rewind(BasicMemory<Word> &memory, size_t boot, uint64_t index) const {
+            check(memory.size(), boot);
+            Word *words = memory.data();
+            const TraceEvent &start = events[boot_starts[boot]];
+            Flags flags{start.getZF(), start.getSF()};
+            for (size_t i = boot_starts[boot + 1]; i-- > boot_starts[boot] + 1;) {
+                const TraceEvent &event = events[i];
+                if (event.kind() != TraceEvent::Kind::Write || event.index() < index) {
+                    flags = {event.getZF(), event.getSF()};
+                    break;
+                }
+                words[event.address] = static_cast<Word>(event.old_value);
+            }
+            return flags;
+        }
+
+        class InvalidTraceException : public std::exception {
+            [[nodiscard]] const char *what() const noexcept override {
+                return "File is not a valid ooasm trace!";
+            }
+        };
+
+        class IncompatibleMemoryException : public std::exception {
+            [[nodiscard]] const char *what() const noexcept override {
+                return "Memory differs in size from memory of traced boot!";
+            }
+        };
+
+    private:
+        void check(MemoryBase::mem_size_t size, size_t boot) const {
+            if (boot >= boots()) {
+                throw std::out_of_range("No such boot in trace");
+            }
+            if (size != memory_size(boot)) {
+                throw IncompatibleMemoryException();
+            }
+            for (size_t i = boot_starts[boot] + 1; i < boot_starts[boot + 1]; ++i) {
+                if (events[i].address >= size) {
+                    throw InvalidTraceException();
+                }
+            }
+        }
+
+        std::vector<TraceEvent> events;
+        // Positions of boot events, followed by number of events.
+        std::vector<size_t> boot_starts;
+    };
+}
+
+using computer::TraceReplay;
+
+#endif //JNP1_6_TRACE_H
@@ -0,0 +1,51 @@
+#ifndef JNP1_6_WORD_H
+#define JNP1_6_WORD_H
+
+#include <cstdint>
+#include <type_traits>
+
+namespace computer {
+    // Arithmetic on memory words of given width. Sums and differences wrap around modulo
+    // 2^BITS and the sign flag is the top bit of the result, the same for every width.
+    template <typename Word>
+    struct WordArithmetic {
+        static_assert(std::is_same_v<Word, int8_t> || std::is_same_v<Word, int16_t> ||
+                      std::is_same_v<Word, int32_t> || std::is_same_v<Word, int64_t>,
+                      "Words are signed integers of 8, 16, 32 or 64 bits");
+
+        using unsigned_t = std::make_unsigned_t<Word>;
+
+        constexpr static unsigned BITS = 8 * sizeof(Word);
+
+        // Word congruent to <value> modulo 2^BITS. Conversion of unsigned value to signed
+        // type is modular, as GCC and Clang define it and C++20 requires.
+        template <typename Integer>
+        [[nodiscard]] constexpr static Word wrap(Integer value) {
+            return static_cast<Word>(static_cast<unsigned_t>(value));
+        }
+
+        [[nodiscard]] constexpr static Word add(Word a, Word b) {
+            return wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+        }
+
+        [[nodiscard]] constexpr static Word sub(Word a, Word b) {
+            return wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+        }
+
+        [[nodiscard]] constexpr static bool zero(Word result) {
+            return result == 0;
+        }
+
+        [[nodiscard]] constexpr static bool sign(Word result) {
+            return result < 0;
+        }
+
+        // Address to which word refers. Negative words are sign-extended, so that they refer
+        // beyond any memory whatever the width.
+        [[nodiscard]] constexpr static uint64_t address(Word word) {
+            return static_cast<uint64_t>(static_cast<int64_t>(word));
+        }
+    };
+}
+
+#endif //JNP1_6_WORD_H